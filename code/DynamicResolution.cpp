@@ -0,0 +1,215 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+
+// 比例按 1/32 取整，避免每帧的微小波动都改变视口
+static const float kScaleStep = 1.0f / 32.0f;
+// 两次调整之间至少间隔的帧数，让平滑后的帧时间跟上新的比例
+static const int kMinFramesBetweenChanges = 15;
+// 帧时间在目标的这个范围内时不调整
+static const float kTolerance = 0.08f;
+// GPU帧时间的指数平滑系数
+static const float kSmoothing = 0.1f;
+
+
+DynamicResolution::DynamicResolution()
+	: enabled(false), dirty(true), sceneActive(false), width(0), height(0), sceneWidth(0), sceneHeight(0),
+	minScale(0.5f), maxScale(1.0f), targetMs(14.0f), scale(1.0f), gpuMs(0.0f), framesSinceChange(0),
+	framebuffer(0), colorBuffer(0), depthBuffer(0), bufferWidth(0), bufferHeight(0),
+	queryIndex(0), queryActive(false)
+{
+	for (int i = 0; i < kQueryCount; i++) {
+		queries[i] = 0;
+		queryPending[i] = false;
+	}
+}
+
+void DynamicResolution::setEnabled(bool value)
+{
+	enabled = value;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::setScaleRange(float newMin, float newMax)
+{
+	minScale = std::min(std::max(newMin, 0.1f), 1.0f);
+	maxScale = std::min(std::max(newMax, minScale), 1.0f);
+	scale = std::min(std::max(scale, minScale), maxScale);
+	// 最大比例决定离屏缓冲的尺寸
+	dirty = true;
+}
+
+void DynamicResolution::setTargetFrameTime(float milliseconds)
+{
+	targetMs = std::max(milliseconds, 1.0f);
+}
+
+void DynamicResolution::resize(int newWidth, int newHeight)
+{
+	if (newWidth != width || newHeight != height) {
+		width = newWidth;
+		height = newHeight;
+		dirty = true;
+	}
+}
+
+void DynamicResolution::create()
+{
+	if (framebuffer != 0) {
+		glDeleteFramebuffers(1, &framebuffer);
+		GLuint buffers[] = { colorBuffer, depthBuffer };
+		glDeleteRenderbuffers(2, buffers);
+		framebuffer = 0;
+		colorBuffer = 0;
+		depthBuffer = 0;
+	}
+	dirty = false;
+	bufferWidth = static_cast<int>(std::ceil(width * maxScale));
+	bufferHeight = static_cast<int>(std::ceil(height * maxScale));
+	if (bufferWidth <= 0 || bufferHeight <= 0) {
+		return;
+	}
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, bufferWidth, bufferHeight);
+	// 与默认帧缓冲的深度格式相同，才能 blit 到窗口和低分辨率半透明目标
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, bufferWidth, bufferHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Framebuffer dynamic resolution incomplete: 0x" << std::hex << status << std::dec << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::readQueries()
+{
+	// endFrame 之后 queryIndex 指向最早发出的查询；从它开始，遇到还没有结果的就停下，保持先后顺序
+	for (int i = 0; i < kQueryCount; i++) {
+		int index = (queryIndex + i) % kQueryCount;
+		if (!queryPending[index]) {
+			continue;
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+		queryPending[index] = false;
+		updateScale(static_cast<float>(elapsed) * 1e-6f);
+	}
+}
+
+void DynamicResolution::updateScale(float frameMs)
+{
+	gpuMs = gpuMs > 0.0f ? gpuMs + (frameMs - gpuMs) * kSmoothing : frameMs;
+	framesSinceChange++;
+	if (!enabled || framesSinceChange < kMinFramesBetweenChanges) {
+		return;
+	}
+	float ratio = targetMs / gpuMs;
+	if (std::abs(ratio - 1.0f) < kTolerance) {
+		return;
+	}
+
+	// 片元开销与像素数成正比，边长按时间比的平方根缩放
+	float wanted = scale * std::sqrt(ratio);
+	wanted = std::floor(wanted / kScaleStep + 0.5f) * kScaleStep;
+	wanted = std::min(std::max(wanted, minScale), maxScale);
+	if (wanted == scale) {
+		return;
+	}
+	// 按新的像素数预估帧时间，不必等平滑值慢慢追上
+	gpuMs *= (wanted * wanted) / (scale * scale);
+	scale = wanted;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::beginFrame()
+{
+	if (queries[0] == 0) {
+		glGenQueries(kQueryCount, queries);
+	}
+	readQueries();
+
+	sceneActive = false;
+	sceneWidth = width;
+	sceneHeight = height;
+	if (enabled) {
+		if (dirty) {
+			create();
+		}
+		if (framebuffer != 0) {
+			sceneActive = true;
+			sceneWidth = std::min(std::max(static_cast<int>(width * scale + 0.5f), 1), bufferWidth);
+			sceneHeight = std::min(std::max(static_cast<int>(height * scale + 0.5f), 1), bufferHeight);
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, getSceneFramebuffer());
+	glViewport(0, 0, sceneWidth, sceneHeight);
+
+	// 上一轮的结果还没有取回时这一帧不计时
+	queryActive = !queryPending[queryIndex];
+	if (queryActive) {
+		glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+	}
+}
+
+void DynamicResolution::resolveScene()
+{
+	if (!sceneActive) {
+		return;
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	// 深度也放大到窗口，之后以原生分辨率绘制的玩家编号仍然被场景遮挡
+	glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+}
+
+void DynamicResolution::endFrame()
+{
+	if (queryActive) {
+		glEndQuery(GL_TIME_ELAPSED);
+		queryPending[queryIndex] = true;
+		queryIndex = (queryIndex + 1) % kQueryCount;
+		queryActive = false;
+	}
+}
+
+void DynamicResolution::clear()
+{
+	if (framebuffer != 0) {
+		glDeleteFramebuffers(1, &framebuffer);
+		GLuint buffers[] = { colorBuffer, depthBuffer };
+		glDeleteRenderbuffers(2, buffers);
+		framebuffer = 0;
+		colorBuffer = 0;
+		depthBuffer = 0;
+	}
+	if (queries[0] != 0) {
+		glDeleteQueries(kQueryCount, queries);
+		for (int i = 0; i < kQueryCount; i++) {
+			queries[i] = 0;
+			queryPending[i] = false;
+		}
+	}
+	queryActive = false;
+	sceneActive = false;
+	dirty = true;
+}
@@ -0,0 +1,232 @@
+#include "FrameGraph.h"
+
+#include <iostream>
+
+
+FrameGraph::FrameGraph()
+{
+}
+
+void FrameGraph::reset()
+{
+	resources.clear();
+	passes.clear();
+}
+
+FrameResource FrameGraph::createTexture(const std::string& name, const TransientTextureDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = false;
+	resource.framebuffer = 0;
+	resource.desc = desc;
+	resource.texture = 0;
+	resource.output = false;
+	resource.refCount = 0;
+	resource.firstPass = -1;
+	resource.lastPass = -1;
+	resources.push_back(resource);
+	return static_cast<FrameResource>(resources.size() - 1);
+}
+
+FrameResource FrameGraph::importFramebuffer(const std::string& name, GLuint framebuffer)
+{
+	FrameResource handle = createTexture(name, TransientTextureDesc());
+	resources[handle].imported = true;
+	resources[handle].framebuffer = framebuffer;
+	return handle;
+}
+
+void FrameGraph::markOutput(FrameResource resource)
+{
+	resources[resource].output = true;
+}
+
+int FrameGraph::addPass(const std::string& name, ExecuteFunction execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.refCount = 0;
+	pass.culled = false;
+	passes.push_back(pass);
+	return static_cast<int>(passes.size() - 1);
+}
+
+void FrameGraph::read(int pass, FrameResource resource)
+{
+	passes[pass].reads.push_back(resource);
+}
+
+void FrameGraph::write(int pass, FrameResource resource)
+{
+	passes[pass].writes.push_back(resource);
+	resources[resource].writers.push_back(pass);
+}
+
+void FrameGraph::cullPasses()
+{
+	// 资源的引用数为读取它的通道数，通道的引用数为它写入的资源数；
+	// 从没有被引用的资源开始，依次剔除不再被引用的写入者，再减少它们所读资源的引用
+	for (Resource& resource : resources) {
+		resource.refCount = resource.output ? 1 : 0;
+	}
+	for (Pass& pass : passes) {
+		pass.refCount = static_cast<int>(pass.writes.size());
+		pass.culled = false;
+		for (FrameResource read : pass.reads) {
+			resources[read].refCount++;
+		}
+	}
+
+	std::vector<FrameResource> unreferenced;
+	for (size_t i = 0; i < passes.size(); i++) {
+		// 什么也不写的通道没有效果
+		if (passes[i].refCount == 0) {
+			passes[i].culled = true;
+			for (FrameResource read : passes[i].reads) {
+				resources[read].refCount--;
+			}
+		}
+	}
+	for (size_t i = 0; i < resources.size(); i++) {
+		if (resources[i].refCount == 0) {
+			unreferenced.push_back(static_cast<FrameResource>(i));
+		}
+	}
+
+	while (!unreferenced.empty()) {
+		FrameResource handle = unreferenced.back();
+		unreferenced.pop_back();
+		for (int writer : resources[handle].writers) {
+			Pass& pass = passes[writer];
+			if (pass.culled || --pass.refCount > 0) {
+				continue;
+			}
+			pass.culled = true;
+			for (FrameResource read : pass.reads) {
+				if (--resources[read].refCount == 0) {
+					unreferenced.push_back(read);
+				}
+			}
+		}
+	}
+}
+
+bool FrameGraph::compile()
+{
+	cullPasses();
+
+	// 临时纹理的生命周期：从第一个用到它的通道到最后一个
+	for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+		const Pass& pass = passes[i];
+		if (pass.culled) {
+			continue;
+		}
+		for (FrameResource read : pass.reads) {
+			Resource& resource = resources[read];
+			if (resource.firstPass < 0 && !resource.imported) {
+				std::cerr << "Frame graph: pass " << pass.name << " reads " << resource.name
+					<< " before it is written" << std::endl;
+			}
+		}
+		for (int list = 0; list < 2; list++) {
+			for (FrameResource handle : (list == 0 ? pass.reads : pass.writes)) {
+				Resource& resource = resources[handle];
+				if (resource.firstPass < 0) {
+					resource.firstPass = i;
+				}
+				resource.lastPass = i;
+			}
+		}
+	}
+
+	// 按执行顺序模拟分配和归还，生命周期已经结束的纹理可以给后面的资源复用
+	bool created = false;
+	for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+		if (passes[i].culled) {
+			continue;
+		}
+		for (size_t r = 0; r < resources.size(); r++) {
+			Resource& resource = resources[r];
+			if (!resource.imported && resource.firstPass == i) {
+				resource.texture = pool.acquire(resource.desc, created);
+			}
+		}
+		for (size_t r = 0; r < resources.size(); r++) {
+			Resource& resource = resources[r];
+			if (!resource.imported && resource.lastPass == i && resource.texture != 0) {
+				pool.release(resource.texture);
+			}
+		}
+	}
+	return created;
+}
+
+void FrameGraph::execute()
+{
+	for (const Pass& pass : passes) {
+		if (!pass.culled && pass.execute) {
+			pass.execute();
+		}
+	}
+	pool.endFrame();
+}
+
+GLuint FrameGraph::getTexture(FrameResource resource) const
+{
+	if (resource == kInvalidFrameResource) {
+		return 0;
+	}
+	return resources[resource].texture;
+}
+
+GLuint FrameGraph::getFramebuffer(FrameResource color, FrameResource depth)
+{
+	FrameResource first = color != kInvalidFrameResource ? color : depth;
+	if (first == kInvalidFrameResource) {
+		return 0;
+	}
+	if (resources[first].imported) {
+		return resources[first].framebuffer;
+	}
+	return pool.getFramebuffer(getTexture(color), getTexture(depth));
+}
+
+int FrameGraph::getCulledPassCount() const
+{
+	int count = 0;
+	for (const Pass& pass : passes) {
+		if (pass.culled) {
+			count++;
+		}
+	}
+	return count;
+}
+
+int FrameGraph::getTransientCount() const
+{
+	int count = 0;
+	for (const Resource& resource : resources) {
+		if (!resource.imported && resource.firstPass >= 0) {
+			count++;
+		}
+	}
+	return count;
+}
+
+void FrameGraph::print(std::ostream& out) const
+{
+	out << "Frame graph: " << passes.size() << " passes (" << getCulledPassCount() << " culled), "
+		<< getTransientCount() << " transient resources in " << pool.getTextureCount() << " textures ("
+		<< pool.getTextureBytes() << " bytes)" << std::endl;
+	for (const Pass& pass : passes) {
+		out << "  " << pass.name << (pass.culled ? " (culled)" : "") << std::endl;
+	}
+}
+
+void FrameGraph::clear()
+{
+	reset();
+	pool.clear();
+}
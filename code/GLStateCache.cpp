@@ -0,0 +1,246 @@
+#include "GLStateCache.h"
+
+#include <limits>
+
+
+static const GLuint kUnknownName = 0xFFFFFFFFu;
+static const GLenum kUnknownEnum = 0xFFFFFFFFu;
+
+
+GLStateCache::GLStateCache()
+{
+	reset();
+}
+
+void GLStateCache::reset()
+{
+	// GL规范中新建上下文的默认值
+	blend = kOff;
+	blendSrc = GL_ONE;
+	blendDst = GL_ZERO;
+	blendSrcAlpha = GL_ONE;
+	blendDstAlpha = GL_ZERO;
+	depthTest = kOff;
+	depthMask = kOn;
+	colorMask = kOn;
+	depthFunc = GL_LESS;
+	cullFace = kOff;
+	polygonOffset = kOff;
+	offsetFactor = 0.0f;
+	offsetUnits = 0.0f;
+
+	program = 0;
+	vao = 0;
+	activeUnit = 0;
+	for (int i = 0; i < kMaxTextureUnits; i++) {
+		for (int j = 0; j < 3; j++) {
+			textures[i][j] = 0;
+		}
+	}
+	resetStats();
+}
+
+void GLStateCache::invalidate()
+{
+	blend = kUnknown;
+	blendSrc = kUnknownEnum;
+	blendDst = kUnknownEnum;
+	blendSrcAlpha = kUnknownEnum;
+	blendDstAlpha = kUnknownEnum;
+	depthTest = kUnknown;
+	depthMask = kUnknown;
+	colorMask = kUnknown;
+	depthFunc = kUnknownEnum;
+	cullFace = kUnknown;
+	polygonOffset = kUnknown;
+	offsetFactor = std::numeric_limits<float>::quiet_NaN();
+	offsetUnits = std::numeric_limits<float>::quiet_NaN();
+
+	invalidateProgram();
+	invalidateVertexArray();
+	activeUnit = kUnknownName;
+	for (int i = 0; i < kMaxTextureUnits; i++) {
+		for (int j = 0; j < 3; j++) {
+			textures[i][j] = kUnknownName;
+		}
+	}
+}
+
+void GLStateCache::invalidateProgram()
+{
+	program = kUnknownName;
+}
+
+void GLStateCache::invalidateVertexArray()
+{
+	vao = kUnknownName;
+}
+
+void GLStateCache::resetStats()
+{
+	stats = Stats();
+}
+
+bool GLStateCache::setToggle(int& current, bool enabled)
+{
+	int wanted = enabled ? kOn : kOff;
+	if (current == wanted) {
+		stats.skipped++;
+		return false;
+	}
+	current = wanted;
+	stats.issued++;
+	return true;
+}
+
+void GLStateCache::setCapability(int& current, GLenum capability, bool enabled)
+{
+	if (setToggle(current, enabled)) {
+		if (enabled) {
+			glEnable(capability);
+		}
+		else {
+			glDisable(capability);
+		}
+	}
+}
+
+void GLStateCache::setBlend(bool enabled)
+{
+	setCapability(blend, GL_BLEND, enabled);
+}
+
+void GLStateCache::setBlendFunc(GLenum src, GLenum dst)
+{
+	if (blendSrc == src && blendDst == dst && blendSrcAlpha == src && blendDstAlpha == dst) {
+		stats.skipped++;
+		return;
+	}
+	blendSrc = src;
+	blendDst = dst;
+	blendSrcAlpha = src;
+	blendDstAlpha = dst;
+	glBlendFunc(src, dst);
+	stats.issued++;
+}
+
+void GLStateCache::setBlendFuncSeparate(GLenum srcColor, GLenum dstColor, GLenum srcAlpha, GLenum dstAlpha)
+{
+	if (blendSrc == srcColor && blendDst == dstColor && blendSrcAlpha == srcAlpha && blendDstAlpha == dstAlpha) {
+		stats.skipped++;
+		return;
+	}
+	blendSrc = srcColor;
+	blendDst = dstColor;
+	blendSrcAlpha = srcAlpha;
+	blendDstAlpha = dstAlpha;
+	glBlendFuncSeparate(srcColor, dstColor, srcAlpha, dstAlpha);
+	stats.issued++;
+}
+
+void GLStateCache::setDepthTest(bool enabled)
+{
+	setCapability(depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void GLStateCache::setDepthMask(bool enabled)
+{
+	if (setToggle(depthMask, enabled)) {
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLStateCache::setColorMask(bool enabled)
+{
+	if (setToggle(colorMask, enabled)) {
+		GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+}
+
+void GLStateCache::setDepthFunc(GLenum func)
+{
+	if (depthFunc == func) {
+		stats.skipped++;
+		return;
+	}
+	depthFunc = func;
+	glDepthFunc(func);
+	stats.issued++;
+}
+
+void GLStateCache::setCullFace(bool enabled)
+{
+	setCapability(cullFace, GL_CULL_FACE, enabled);
+}
+
+void GLStateCache::setPolygonOffset(bool enabled, float factor, float units)
+{
+	setCapability(polygonOffset, GL_POLYGON_OFFSET_FILL, enabled);
+	if (!enabled) {
+		return;
+	}
+	if (offsetFactor == factor && offsetUnits == units) {
+		stats.skipped++;
+		return;
+	}
+	offsetFactor = factor;
+	offsetUnits = units;
+	glPolygonOffset(factor, units);
+	stats.issued++;
+}
+
+void GLStateCache::useProgram(GLuint newProgram)
+{
+	if (program == newProgram) {
+		stats.skipped++;
+		return;
+	}
+	program = newProgram;
+	glUseProgram(newProgram);
+	stats.issued++;
+}
+
+void GLStateCache::bindVertexArray(GLuint newVao)
+{
+	if (vao == newVao) {
+		stats.skipped++;
+		return;
+	}
+	vao = newVao;
+	glBindVertexArray(newVao);
+	stats.issued++;
+}
+
+int GLStateCache::targetSlot(GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	default: return 0;
+	}
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= static_cast<GLuint>(kMaxTextureUnits)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		activeUnit = unit;
+		stats.issued += 2;
+		return;
+	}
+	GLuint& bound = textures[unit][targetSlot(target)];
+	if (bound == texture) {
+		stats.skipped++;
+		return;
+	}
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		stats.issued++;
+	}
+	bound = texture;
+	glBindTexture(target, texture);
+	stats.issued++;
+}
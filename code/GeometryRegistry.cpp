@@ -0,0 +1,169 @@
+#include "GeometryRegistry.h"
+
+
+template <typename T>
+static void appendBytes(std::string& key, const std::vector<T>& data)
+{
+	if (!data.empty()) {
+		key.append(reinterpret_cast<const char*>(&data[0]), data.size() * sizeof(T));
+	}
+	key += '|';
+}
+
+static bool isUniformColor(const std::vector<glm::vec3>& colors)
+{
+	for (size_t i = 1; i < colors.size(); i++) {
+		if (colors[i] != colors[0]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+GeometryRegistry::GeometryRegistry() : bufferBytes(0), vertexPacking(kVertexPackingFloat)
+{
+}
+
+GeometryRegistry::~GeometryRegistry()
+{
+	for (auto& entry : entries) {
+		delete entry.second;
+	}
+	entries.clear();
+}
+
+GeometryHandle* GeometryRegistry::registerMesh(TriMesh* mesh, glm::vec3& constantColor)
+{
+	std::vector<glm::vec3> points = mesh->getPoints();
+	std::vector<glm::vec3> colors = mesh->getColors();
+	std::vector<glm::vec3> normals = mesh->getNormals();
+	std::vector<glm::vec2> texcoords = mesh->getTexCoords();
+	std::vector<GLuint> indices = mesh->getIndices();
+
+	// 单色网格（程序生成的立方体、平面）去掉颜色数组，颜色改为每次绘制传入
+	bool uniformColor = !colors.empty() && isUniformColor(colors);
+	constantColor = uniformColor ? colors[0] : glm::vec3(1.0f, 1.0f, 1.0f);
+	if (uniformColor) {
+		colors.clear();
+	}
+
+	std::string key;
+	appendBytes(key, points);
+	appendBytes(key, colors);
+	appendBytes(key, normals);
+	appendBytes(key, texcoords);
+	appendBytes(key, indices);
+
+	GeometryHandle* handle = NULL;
+	auto found = entries.find(key);
+	if (found != entries.end()) {
+		handle = found->second;
+	}
+	else {
+		handle = upload(points, colors, normals, texcoords, indices);
+		entries[key] = handle;
+	}
+	handle->refCount++;
+	return handle;
+}
+
+GeometryHandle* GeometryRegistry::upload(const std::vector<glm::vec3>& points, const std::vector<glm::vec3>& colors,
+	const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texcoords,
+	const std::vector<GLuint>& indices)
+{
+	GeometryHandle* handle = new GeometryHandle();
+	handle->vertexCount = static_cast<GLsizei>(points.size());
+	handle->count = indices.empty() ? handle->vertexCount : static_cast<GLsizei>(indices.size());
+	handle->hasVertexColor = !colors.empty();
+
+	VertexStreams streams;
+	streams.points = &points;
+	streams.colors = &colors;
+	streams.normals = &normals;
+	streams.texcoords = &texcoords;
+	handle->format = VertexFormat::choose(streams, vertexPacking);
+	std::vector<unsigned char> vertices = handle->format.pack(streams);
+
+	// 创建顶点数组对象
+	glGenVertexArrays(1, &handle->vao);
+	glBindVertexArray(handle->vao);
+
+	// 创建并初始化顶点缓存对象，所有属性交错存放在一个数组中
+	glGenBuffers(1, &handle->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, handle->vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+	bufferBytes += vertices.size();
+
+	// 索引网格的下标放在单独的缓存中，绑定关系记录在顶点数组对象里
+	if (!indices.empty()) {
+		size_t indicesSize = indices.size() * sizeof(GLuint);
+		glGenBuffers(1, &handle->ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle->ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, &indices[0], GL_STATIC_DRAW);
+		bufferBytes += indicesSize;
+	}
+
+	bindAttributes(handle);
+
+	glGenVertexArrays(1, &handle->positionVao);
+	glBindVertexArray(handle->positionVao);
+	bindPositionAttributes(handle);
+
+	glBindVertexArray(0);
+	return handle;
+}
+
+void GeometryRegistry::bindAttributes(const GeometryHandle* handle)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, handle->vbo);
+	handle->format.bind(handle->vertexCount);
+
+	if (handle->ebo != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle->ebo);
+	}
+}
+
+void GeometryRegistry::bindPositionAttributes(const GeometryHandle* handle)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, handle->vbo);
+	handle->format.bindPositions();
+
+	if (handle->ebo != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle->ebo);
+	}
+}
+
+void GeometryRegistry::clear()
+{
+	for (auto& entry : entries) {
+		glDeleteBuffers(1, &entry.second->vbo);
+		if (entry.second->ebo != 0) {
+			glDeleteBuffers(1, &entry.second->ebo);
+		}
+		glDeleteVertexArrays(1, &entry.second->vao);
+		glDeleteVertexArrays(1, &entry.second->positionVao);
+		delete entry.second;
+	}
+	entries.clear();
+	bufferBytes = 0;
+}
+
+int GeometryRegistry::getUniqueCount() const
+{
+	return static_cast<int>(entries.size());
+}
+
+int GeometryRegistry::getReferenceCount() const
+{
+	int count = 0;
+	for (const auto& entry : entries) {
+		count += entry.second->refCount;
+	}
+	return count;
+}
+
+size_t GeometryRegistry::getBufferBytes() const
+{
+	return bufferBytes;
+}
@@ -0,0 +1,233 @@
+#include "GpuCrowdCulling.h"
+
+#include <vector>
+
+
+// GL 4.3 的枚举值，3.3 的头文件中没有
+static const GLenum kShaderStorageBuffer = 0x90D2;
+static const GLenum kDrawIndirectBuffer = 0x8F3F;
+static const GLbitfield kVertexAttribArrayBarrierBit = 0x00000001;
+static const GLbitfield kCommandBarrierBit = 0x00000040;
+static const GLbitfield kBufferUpdateBarrierBit = 0x00000200;
+static const GLbitfield kShaderStorageBarrierBit = 0x00002000;
+
+// 与 crowd_cull_cshader.glsl 中的布局对应
+static const GLuint kInstanceBinding = 0;
+static const GLuint kVisibleBinding = 1;
+static const GLuint kCommandBinding = 2;
+static const GLuint kWorkGroupSize = 64;
+static const int kMaxCullViews = 2;
+// 命令缓存开头是可见数量的计数器（按16字节对齐），之后每条命令5个 uint，
+// DrawElementsIndirectCommand 和 DrawArraysIndirectCommand 的 instanceCount 都在第1个
+static const GLsizeiptr kCommandStart = 4 * sizeof(GLuint);
+static const GLsizeiptr kCommandStride = 5 * sizeof(GLuint);
+
+// 按 Gribb-Hartmann 方法从投影矩阵中取出6个视锥体平面，法线朝内并归一化
+static void extractFrustumPlanes(const glm::mat4& m, glm::vec4* planes)
+{
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 1e-6f) {
+			planes[i] /= length;
+		}
+	}
+}
+
+GpuCrowdCulling::GpuCrowdCulling()
+	: dispatchCompute(NULL), memoryBarrier(NULL), drawElementsIndirect(NULL), drawArraysIndirect(NULL),
+	supported(false), cullProgram(NULL), finalizeProgram(NULL), modelLocation(-1), planesLocation(-1),
+	viewCountLocation(-1), boundsLocation(-1), shadowLightLocation(-1), castShadowsLocation(-1),
+	instanceCountLocation(-1), partCountLocation(-1), visibleBuffer(0), commandBuffer(0), capacity(0),
+	boundCenterY(0.0f), boundRadius(1.0f)
+{
+}
+
+bool GpuCrowdCulling::loadFunctions()
+{
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool available = major > 4 || (major == 4 && minor >= 3) ||
+		(glfwExtensionSupported("GL_ARB_compute_shader") &&
+		glfwExtensionSupported("GL_ARB_shader_storage_buffer_object") &&
+		glfwExtensionSupported("GL_ARB_draw_indirect"));
+	if (!available) {
+		return false;
+	}
+
+	dispatchCompute = reinterpret_cast<DispatchComputeProc>(glfwGetProcAddress("glDispatchCompute"));
+	memoryBarrier = reinterpret_cast<MemoryBarrierProc>(glfwGetProcAddress("glMemoryBarrier"));
+	drawElementsIndirect = reinterpret_cast<DrawElementsIndirectProc>(glfwGetProcAddress("glDrawElementsIndirect"));
+	drawArraysIndirect = reinterpret_cast<DrawArraysIndirectProc>(glfwGetProcAddress("glDrawArraysIndirect"));
+	return dispatchCompute != NULL && memoryBarrier != NULL && drawElementsIndirect != NULL && drawArraysIndirect != NULL;
+}
+
+bool GpuCrowdCulling::init(ShaderCache& shaderCache, const std::string& computeShaderFile, const SpectatorCrowd& crowd)
+{
+	clear();
+	if (!loadFunctions()) {
+		return false;
+	}
+
+	cullProgram = shaderCache.getComputeProgram(computeShaderFile);
+	finalizeProgram = shaderCache.getComputeProgram(computeShaderFile, "#define FINALIZE");
+	if (cullProgram == NULL || finalizeProgram == NULL) {
+		clear();
+		return false;
+	}
+	modelLocation = glGetUniformLocation(cullProgram->program, "crowdModel");
+	planesLocation = glGetUniformLocation(cullProgram->program, "frustumPlanes");
+	viewCountLocation = glGetUniformLocation(cullProgram->program, "viewCount");
+	boundsLocation = glGetUniformLocation(cullProgram->program, "bounds");
+	shadowLightLocation = glGetUniformLocation(cullProgram->program, "shadowLight");
+	castShadowsLocation = glGetUniformLocation(cullProgram->program, "castShadows");
+	instanceCountLocation = glGetUniformLocation(cullProgram->program, "instanceCount");
+	partCountLocation = glGetUniformLocation(finalizeProgram->program, "partCount");
+
+	// 每个部位一条命令，除 instanceCount 外都不变，在这里写好；instanceCount 每帧由计算着色器写入
+	std::vector<GLuint> commands(kCommandStart / sizeof(GLuint), 0);
+	for (int i = 0; i < crowd.getPartCount(); i++) {
+		const GeometryHandle* geometry = crowd.getPart(i).geometry;
+		Part part;
+		part.indexed = geometry->ebo != 0;
+		part.vao = 0;
+		parts.push_back(part);
+		// 有索引时为 count, instanceCount, firstIndex, baseVertex, baseInstance；
+		// 没有索引时为 count, instanceCount, first, baseInstance，最后一个 uint 不使用
+		GLuint command[5] = { static_cast<GLuint>(geometry->count), 0, static_cast<GLuint>(geometry->first), 0, 0 };
+		commands.insert(commands.end(), command, command + 5);
+	}
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(kDrawIndirectBuffer, commandBuffer);
+	glBufferData(kDrawIndirectBuffer, commands.size() * sizeof(GLuint), &commands[0], GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &visibleBuffer);
+	reserve(crowd.getInstanceCount());
+	for (size_t i = 0; i < parts.size(); i++) {
+		parts[i].vao = crowd.createInstanceVertexArray(static_cast<int>(i), visibleBuffer);
+	}
+	supported = true;
+	return true;
+}
+
+void GpuCrowdCulling::setBounds(float centerY, float radius)
+{
+	boundCenterY = centerY;
+	boundRadius = radius;
+}
+
+void GpuCrowdCulling::reserve(GLsizei count)
+{
+	if (count <= capacity && capacity > 0) {
+		return;
+	}
+	// 顶点数组对象记录的是缓存对象，重新分配存储后不需要重建
+	capacity = count > 0 ? count : 1;
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(CrowdInstance), NULL, GL_DYNAMIC_COPY);
+}
+
+void GpuCrowdCulling::cull(const SpectatorCrowd& crowd, const glm::mat4& model, const glm::mat4* viewProjections,
+	int viewCount, bool castShadows, const glm::vec3& lightPosition, float shadowPlaneY)
+{
+	if (!supported) {
+		return;
+	}
+	GLsizei instanceCount = crowd.getInstanceCount();
+	reserve(instanceCount);
+
+	glm::vec4 planes[kMaxCullViews * 6];
+	viewCount = viewCount < kMaxCullViews ? viewCount : kMaxCullViews;
+	for (int view = 0; view < viewCount; view++) {
+		extractFrustumPlanes(viewProjections[view], &planes[view * 6]);
+	}
+
+	// 计数器清零；上一帧使用这个缓存的绘制由驱动负责同步
+	GLuint zero = 0;
+	glBindBuffer(kDrawIndirectBuffer, commandBuffer);
+	glBufferSubData(kDrawIndirectBuffer, 0, sizeof(GLuint), &zero);
+
+	glBindBufferBase(kShaderStorageBuffer, kInstanceBinding, crowd.getInstanceBuffer());
+	glBindBufferBase(kShaderStorageBuffer, kVisibleBinding, visibleBuffer);
+	glBindBufferBase(kShaderStorageBuffer, kCommandBinding, commandBuffer);
+
+	glUseProgram(cullProgram->program);
+	glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+	glUniform4fv(planesLocation, viewCount * 6, &planes[0][0]);
+	glUniform1i(viewCountLocation, viewCount);
+	glUniform2f(boundsLocation, boundCenterY, boundRadius);
+	glUniform4f(shadowLightLocation, lightPosition.x, lightPosition.y, lightPosition.z, shadowPlaneY);
+	glUniform1i(castShadowsLocation, castShadows ? 1 : 0);
+	glUniform1ui(instanceCountLocation, static_cast<GLuint>(instanceCount));
+	if (instanceCount > 0) {
+		dispatchCompute((instanceCount + kWorkGroupSize - 1) / kWorkGroupSize, 1, 1);
+	}
+	// 计数器全部累加完之后才能写入命令
+	memoryBarrier(kShaderStorageBarrierBit);
+
+	glUseProgram(finalizeProgram->program);
+	glUniform1ui(partCountLocation, static_cast<GLuint>(parts.size()));
+	dispatchCompute((static_cast<GLuint>(parts.size()) + kWorkGroupSize - 1) / kWorkGroupSize, 1, 1);
+	// 之后的间接绘制读取命令，实例属性读取可见实例缓存；
+	// 统计时读回计数器、下一帧清零计数器都要排在计算着色器的原子操作之后
+	memoryBarrier(kCommandBarrierBit | kVertexAttribArrayBarrierBit | kBufferUpdateBarrierBit);
+	glUseProgram(0);
+}
+
+void GpuCrowdCulling::drawPart(int index) const
+{
+	// 场景中只有这里使用间接绘制缓存的绑定点，每次绘制前绑定一次，不经过状态缓存
+	glBindBuffer(kDrawIndirectBuffer, commandBuffer);
+	const void* offset = BUFFER_OFFSET(kCommandStart + index * kCommandStride);
+	if (parts[index].indexed) {
+		drawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset);
+	}
+	else {
+		drawArraysIndirect(GL_TRIANGLES, offset);
+	}
+}
+
+GLuint GpuCrowdCulling::readVisibleCount() const
+{
+	if (!supported) {
+		return 0;
+	}
+	GLuint count = 0;
+	glBindBuffer(kDrawIndirectBuffer, commandBuffer);
+	glGetBufferSubData(kDrawIndirectBuffer, 0, sizeof(GLuint), &count);
+	return count;
+}
+
+void GpuCrowdCulling::clear()
+{
+	for (const Part& part : parts) {
+		if (part.vao != 0) {
+			glDeleteVertexArrays(1, &part.vao);
+		}
+	}
+	parts.clear();
+	if (visibleBuffer != 0) {
+		glDeleteBuffers(1, &visibleBuffer);
+		visibleBuffer = 0;
+	}
+	if (commandBuffer != 0) {
+		glDeleteBuffers(1, &commandBuffer);
+		commandBuffer = 0;
+	}
+	// 程序由着色器缓存持有
+	cullProgram = NULL;
+	finalizeProgram = NULL;
+	capacity = 0;
+	supported = false;
+}
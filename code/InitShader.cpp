@@ -33,31 +33,30 @@ readShaderSource(const char* shaderFile)
 }
 
 
-// Create a GLSL program object from vertex and fragment shader files
+// Create a GLSL program object from vertex and fragment shader source strings
 GLuint
-InitShader(const char* vShaderFile, const char* fShaderFile)
+InitShaderFromSource(const char* vShaderSource, const char* fShaderSource,
+		     const char* vShaderName, const char* fShaderName, GLuint program)
 {
     struct Shader {
 	const char*  filename;
 	GLenum       type;
-	GLchar*      source;
+	const GLchar* source;
     }  shaders[2] = {
-	{ vShaderFile, GL_VERTEX_SHADER, NULL },
-	{ fShaderFile, GL_FRAGMENT_SHADER, NULL }
+	{ vShaderName, GL_VERTEX_SHADER, vShaderSource },
+	{ fShaderName, GL_FRAGMENT_SHADER, fShaderSource }
     };
 
-    GLuint program = glCreateProgram();
+    /* the caller may pass a program with parameters set before linking */
+    if ( program == 0 ) {
+	program = glCreateProgram();
+    }
     
     for ( int i = 0; i < 2; ++i ) {
 	Shader& s = shaders[i];
-	s.source = readShaderSource( s.filename );
-	if ( shaders[i].source == NULL ) {
-	    std::cerr << "Failed to read " << s.filename << std::endl;
-	    exit( EXIT_FAILURE );
-	}
 
 	GLuint shader = glCreateShader( s.type );
-	glShaderSource( shader, 1, (const GLchar**) &s.source, NULL );
+	glShaderSource( shader, 1, &s.source, NULL );
 	glCompileShader( shader );
 
 	GLint  compiled;
@@ -74,9 +73,9 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
 	    exit( EXIT_FAILURE );
 	}
 
-	delete [] s.source;
-
 	glAttachShader( program, shader );
+	/* the program keeps the shader alive until it is deleted */
+	glDeleteShader( shader );
     }
 
     /* link  and error check */
@@ -102,4 +101,28 @@ InitShader(const char* vShaderFile, const char* fShaderFile)
     return program;
 }
 
+
+// Create a GLSL program object from vertex and fragment shader files
+GLuint
+InitShader(const char* vShaderFile, const char* fShaderFile)
+{
+    char* vSource = readShaderSource( vShaderFile );
+    if ( vSource == NULL ) {
+	std::cerr << "Failed to read " << vShaderFile << std::endl;
+	exit( EXIT_FAILURE );
+    }
+    char* fSource = readShaderSource( fShaderFile );
+    if ( fSource == NULL ) {
+	std::cerr << "Failed to read " << fShaderFile << std::endl;
+	exit( EXIT_FAILURE );
+    }
+
+    GLuint program = InitShaderFromSource( vSource, fSource, vShaderFile, fShaderFile );
+
+    delete [] vSource;
+    delete [] fSource;
+
+    return program;
+}
+
 }  // Close namespace Angel block
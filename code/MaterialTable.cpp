@@ -0,0 +1,59 @@
+#include "MaterialTable.h"
+
+
+MaterialTable::MaterialTable() : buffer(0)
+{
+}
+
+int MaterialTable::add(const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular, float shininess)
+{
+	MaterialData material;
+	material.ambient = ambient;
+	material.diffuse = diffuse;
+	material.specular = glm::vec4(specular.x, specular.y, specular.z, shininess);
+
+	for (size_t i = 0; i < materials.size(); i++) {
+		const MaterialData& existing = materials[i];
+		if (existing.ambient == material.ambient && existing.diffuse == material.diffuse &&
+			existing.specular == material.specular) {
+			return static_cast<int>(i);
+		}
+	}
+	if (static_cast<int>(materials.size()) >= kMaxMaterials) {
+		std::cerr << "Material table is full, using the default material" << std::endl;
+		return 0;
+	}
+	materials.push_back(material);
+	return static_cast<int>(materials.size()) - 1;
+}
+
+int MaterialTable::addFromMesh(TriMesh* mesh)
+{
+	return add(mesh->getAmbient(), mesh->getDiffuse(), mesh->getSpecular(), mesh->getShininess());
+}
+
+void MaterialTable::upload(GLuint binding)
+{
+	// 总是上传整张表的大小，着色器中按 MAX_MATERIALS 声明数组
+	if (buffer == 0) {
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, kMaxMaterials * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+	}
+	else {
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	}
+	if (!materials.empty()) {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialData), &materials[0]);
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+void MaterialTable::clear()
+{
+	if (buffer != 0) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	materials.clear();
+}
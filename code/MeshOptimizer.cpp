@@ -0,0 +1,308 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Forsyth 评分参数
+static const float kCacheDecayPower = 1.5f;
+static const float kLastTriangleScore = 0.75f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+
+static float vertexScore(int cachePosition, int remaining)
+{
+	// 没有剩余三角形的顶点不再参与评分
+	if (remaining == 0) {
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// 刚用过的三个顶点分数固定，避免总是沿着同一条带走
+			score = kLastTriangleScore;
+		}
+		else {
+			float scaler = 1.0f / (kVertexCacheSize - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+		}
+	}
+	// 剩余三角形越少分数越高，尽快把孤立的三角形画掉
+	score += kValenceBoostScale * powf(static_cast<float>(remaining), -kValenceBoostPower);
+	return score;
+}
+
+static unsigned int corner(const vec3i& face, int index)
+{
+	return index == 0 ? face.x : (index == 1 ? face.y : face.z);
+}
+
+
+void MeshOptimizer::optimizeVertexCache(std::vector<vec3i>& faces, size_t vertexCount)
+{
+	size_t triangleCount = faces.size();
+	if (triangleCount == 0 || vertexCount == 0) {
+		return;
+	}
+
+	// 每个顶点相邻的三角形，存成一个连续的数组
+	std::vector<int> remaining(vertexCount, 0);
+	for (const auto& face : faces) {
+		for (int k = 0; k < 3; k++) {
+			remaining[corner(face, k)]++;
+		}
+	}
+	std::vector<int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<int> adjacency(triangleCount * 3);
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			adjacency[fill[corner(faces[t], k)]++] = static_cast<int>(t);
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = vertexScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	int best = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		const vec3i& face = faces[t];
+		triangleScores[t] = vertexScores[face.x] + vertexScores[face.y] + vertexScores[face.z];
+		if (triangleScores[t] > triangleScores[best]) {
+			best = static_cast<int>(t);
+		}
+	}
+
+	std::vector<int> cache;
+	std::vector<int> newCache;
+	std::vector<vec3i> result;
+	result.reserve(triangleCount);
+	size_t cursor = 0;
+	while (result.size() < triangleCount) {
+		if (best < 0) {
+			// 缓存中的顶点已经没有剩余三角形，按原顺序取下一个
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = static_cast<int>(cursor);
+		}
+		const vec3i face = faces[best];
+		emitted[best] = 1;
+		result.push_back(face);
+
+		// 从三个顶点的邻接表中去掉这个三角形
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = corner(face, k);
+			int begin = offsets[v];
+			int end = begin + remaining[v];
+			for (int i = begin; i < end; i++) {
+				if (adjacency[i] == best) {
+					std::swap(adjacency[i], adjacency[end - 1]);
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// LRU：刚用过的顶点放在最前面，超出缓存大小的顶点被挤出
+		newCache.clear();
+		for (int k = 0; k < 3; k++) {
+			int v = static_cast<int>(corner(face, k));
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+		for (int v : cache) {
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+
+		// 更新位置发生变化的顶点的分数，并把差值加到它们相邻的三角形上
+		for (size_t i = 0; i < newCache.size(); i++) {
+			int v = newCache[i];
+			cachePosition[v] = i < static_cast<size_t>(kVertexCacheSize) ? static_cast<int>(i) : -1;
+			float score = vertexScore(cachePosition[v], remaining[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (int j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+				triangleScores[adjacency[j]] += delta;
+			}
+		}
+		if (newCache.size() > static_cast<size_t>(kVertexCacheSize)) {
+			newCache.resize(kVertexCacheSize);
+		}
+		cache.swap(newCache);
+
+		// 下一个三角形只在缓存中的顶点相邻的三角形里找
+		best = -1;
+		float bestScore = -1.0f;
+		for (int v : cache) {
+			for (int j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+				int t = adjacency[j];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+	}
+	faces.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<vec3i>& faces, const std::vector<glm::vec3>& positions, float threshold)
+{
+	size_t triangleCount = faces.size();
+	if (triangleCount < 2 || positions.empty()) {
+		return;
+	}
+
+	// 用 FIFO 模拟缓存，记录每个顶点进入缓存的时间
+	std::vector<unsigned int> cacheTime(positions.size(), 0);
+	unsigned int time = kVertexCacheSize + 1;
+	auto missCount = [&](const vec3i& face) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = corner(face, k);
+			if (time - cacheTime[v] > static_cast<unsigned int>(kVertexCacheSize)) {
+				cacheTime[v] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+
+	// 硬边界：三个顶点都不在缓存中的三角形，说明顶点缓存优化已经换到了另一块区域
+	std::vector<size_t> hardStarts;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (missCount(faces[t]) == 3) {
+			hardStarts.push_back(t);
+		}
+	}
+	if (hardStarts.empty() || hardStarts[0] != 0) {
+		hardStarts.insert(hardStarts.begin(), 0);
+	}
+	hardStarts.push_back(triangleCount);
+
+	// 软边界：在每个硬分块内部，当前小块的失效率降到分块失效率的 threshold 倍以内时就可以切开，
+	// 切开后缓存从空开始，失效率的上升不会超过 threshold
+	std::vector<size_t> starts;
+	for (size_t h = 0; h + 1 < hardStarts.size(); h++) {
+		size_t begin = hardStarts[h];
+		size_t end = hardStarts[h + 1];
+
+		time += kVertexCacheSize + 1;
+		int blockMisses = 0;
+		for (size_t t = begin; t < end; t++) {
+			blockMisses += missCount(faces[t]);
+		}
+		float blockACMR = static_cast<float>(blockMisses) / (end - begin);
+
+		time += kVertexCacheSize + 1;
+		starts.push_back(begin);
+		int misses = 0;
+		size_t count = 0;
+		for (size_t t = begin; t < end; t++) {
+			misses += missCount(faces[t]);
+			count++;
+			if (t + 1 < end && static_cast<float>(misses) / count <= threshold * blockACMR) {
+				starts.push_back(t + 1);
+				time += kVertexCacheSize + 1;
+				misses = 0;
+				count = 0;
+			}
+		}
+	}
+	starts.push_back(triangleCount);
+
+	// 每个簇按面积加权的中心和法向量；中心在模型外侧且朝外的簇先画，更可能挡住后面的簇
+	glm::vec3 meshCenter(0.0f, 0.0f, 0.0f);
+	float meshArea = 0.0f;
+	size_t clusterCount = starts.size() - 1;
+	std::vector<glm::vec3> centers(clusterCount);
+	std::vector<glm::vec3> clusterNormals(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		glm::vec3 center(0.0f, 0.0f, 0.0f);
+		glm::vec3 normal(0.0f, 0.0f, 0.0f);
+		float area = 0.0f;
+		for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+			const glm::vec3& p0 = positions[faces[t].x];
+			const glm::vec3& p1 = positions[faces[t].y];
+			const glm::vec3& p2 = positions[faces[t].z];
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(n);
+			center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+		centers[c] = area > 0.0f ? center / area : positions[faces[starts[c]].x];
+		clusterNormals[c] = glm::length(normal) > 1e-12f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 0.0f);
+		meshCenter += center;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f) {
+		meshCenter /= meshArea;
+	}
+
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		sortKeys[c] = glm::dot(centers[c] - meshCenter, clusterNormals[c]);
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<vec3i> result;
+	result.reserve(triangleCount);
+	for (size_t c : order) {
+		result.insert(result.end(), faces.begin() + starts[c], faces.begin() + starts[c + 1]);
+	}
+	faces.swap(result);
+}
+
+std::vector<int> MeshOptimizer::optimizeVertexFetch(std::vector<vec3i>& faces, size_t vertexCount)
+{
+	std::vector<int> remap(vertexCount, -1);
+	int next = 0;
+	for (auto& face : faces) {
+		unsigned int* indices[3] = { &face.x, &face.y, &face.z };
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = *indices[k];
+			if (remap[v] < 0) {
+				remap[v] = next++;
+			}
+			*indices[k] = static_cast<unsigned int>(remap[v]);
+		}
+	}
+	return remap;
+}
+
+float MeshOptimizer::computeACMR(const std::vector<vec3i>& faces, size_t vertexCount, int cacheSize)
+{
+	if (faces.empty()) {
+		return 0.0f;
+	}
+	// FIFO 缓存
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int time = static_cast<unsigned int>(cacheSize) + 1;
+	int misses = 0;
+	for (const auto& face : faces) {
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = corner(face, k);
+			if (time - cacheTime[v] > static_cast<unsigned int>(cacheSize)) {
+				cacheTime[v] = time++;
+				misses++;
+			}
+		}
+	}
+	return static_cast<float>(misses) / faces.size();
+}
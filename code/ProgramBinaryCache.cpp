@@ -0,0 +1,268 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+
+// GL 4.1 的枚举值，3.3 的头文件中没有
+static const GLenum kNumProgramBinaryFormats = 0x87FE;
+static const GLenum kProgramBinaryLength = 0x8741;
+static const GLenum kProgramBinaryRetrievableHint = 0x8257;
+
+static const char kBinaryMagic[4] = { 'P', 'B', 'I', 'N' };
+static const uint32_t kBinaryVersion = 1;
+
+// 缓存文件头，后面紧跟驱动返回的二进制数据
+struct BinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t length;
+	uint64_t hash;
+};
+
+#ifdef _WIN32
+static std::wstring toWide(const std::string& utf8)
+{
+	if (utf8.empty()) {
+		return std::wstring();
+	}
+	int size = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, NULL, 0);
+	if (size <= 0) {
+		return std::wstring();
+	}
+	std::wstring wide(static_cast<size_t>(size - 1), L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, &wide[0], size);
+	return wide;
+}
+#endif
+
+// 路径使用UTF-8，Windows下转换为宽字符，避免中文路径打开失败
+static FILE* openFile(const std::string& path, const char* mode)
+{
+#ifdef _WIN32
+	std::wstring wideMode(mode, mode + strlen(mode));
+	return _wfopen(toWide(path).c_str(), wideMode.c_str());
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+static void removeFile(const std::string& path)
+{
+#ifdef _WIN32
+	_wremove(toWide(path).c_str());
+#else
+	remove(path.c_str());
+#endif
+}
+
+static bool renameFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+	// Windows 下目标已存在时 rename 会失败
+	_wremove(toWide(to).c_str());
+	return _wrename(toWide(from).c_str(), toWide(to).c_str()) == 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static void makeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	_wmkdir(toWide(path).c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+static void hashBytes(uint64_t& hash, const char* data, size_t size)
+{
+	// FNV-1a
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+}
+
+static std::string getGLString(GLenum name)
+{
+	const GLubyte* value = glGetString(name);
+	return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+
+ProgramBinaryCache::ProgramBinaryCache()
+	: getProgramBinary(NULL), programBinary(NULL), programParameteri(NULL), enabled(false), loadCount(0), storeCount(0), rejectCount(0)
+{
+}
+
+bool ProgramBinaryCache::init(const std::string& cacheDirectory)
+{
+	enabled = false;
+	directory = cacheDirectory;
+	if (directory.empty()) {
+		return false;
+	}
+
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 1) ||
+		glfwExtensionSupported("GL_ARB_get_program_binary");
+	if (!supported) {
+		return false;
+	}
+
+	getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(glfwGetProcAddress("glGetProgramBinary"));
+	programBinary = reinterpret_cast<ProgramBinaryProc>(glfwGetProcAddress("glProgramBinary"));
+	programParameteri = reinterpret_cast<ProgramParameteriProc>(glfwGetProcAddress("glProgramParameteri"));
+	if (getProgramBinary == NULL || programBinary == NULL || programParameteri == NULL) {
+		return false;
+	}
+
+	// 有的驱动支持这组函数但不提供任何二进制格式
+	GLint formatCount = 0;
+	glGetIntegerv(kNumProgramBinaryFormats, &formatCount);
+	if (formatCount <= 0) {
+		return false;
+	}
+
+	driver = getGLString(GL_VENDOR) + '\n' + getGLString(GL_RENDERER) + '\n' + getGLString(GL_VERSION);
+	makeDirectory(directory);
+	enabled = true;
+	return true;
+}
+
+uint64_t ProgramBinaryCache::hashSources(const std::string& vSource, const std::string& fSource) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	hashBytes(hash, vSource.c_str(), vSource.size() + 1);
+	hashBytes(hash, fSource.c_str(), fSource.size() + 1);
+	hashBytes(hash, driver.c_str(), driver.size() + 1);
+	return hash;
+}
+
+std::string ProgramBinaryCache::makePath(uint64_t hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+	return directory + "/" + name;
+}
+
+GLuint ProgramBinaryCache::load(const std::string& vSource, const std::string& fSource)
+{
+	if (!enabled) {
+		return 0;
+	}
+	uint64_t hash = hashSources(vSource, fSource);
+	std::string path = makePath(hash);
+	FILE* fp = openFile(path, "rb");
+	if (fp == NULL) {
+		return 0;
+	}
+
+	BinaryHeader header;
+	std::vector<char> binary;
+	bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) == 0 &&
+		header.version == kBinaryVersion &&
+		header.hash == hash &&
+		header.length > 0;
+	if (valid) {
+		// 文件损坏时 length 不可信，不能超过头部之后剩余的字节数
+		long start = ftell(fp);
+		valid = start >= 0 && fseek(fp, 0, SEEK_END) == 0;
+		long end = valid ? ftell(fp) : -1;
+		valid = valid && end >= start && header.length <= static_cast<unsigned long>(end - start) &&
+			fseek(fp, start, SEEK_SET) == 0;
+	}
+	if (valid) {
+		binary.resize(header.length);
+		valid = fread(&binary[0], 1, binary.size(), fp) == binary.size();
+	}
+	fclose(fp);
+
+	GLuint program = 0;
+	if (valid) {
+		program = glCreateProgram();
+		programBinary(program, header.format, &binary[0], static_cast<GLsizei>(binary.size()));
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			// 驱动更新或格式变化，缓存失效，回退到正常编译
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+
+	if (program == 0) {
+		rejectCount++;
+		removeFile(path);
+		return 0;
+	}
+	loadCount++;
+	return program;
+}
+
+GLuint ProgramBinaryCache::createProgram() const
+{
+	GLuint program = glCreateProgram();
+	if (enabled) {
+		programParameteri(program, kProgramBinaryRetrievableHint, GL_TRUE);
+	}
+	return program;
+}
+
+void ProgramBinaryCache::store(GLuint program, const std::string& vSource, const std::string& fSource)
+{
+	if (!enabled) {
+		return;
+	}
+	GLint length = 0;
+	glGetProgramiv(program, kProgramBinaryLength, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	BinaryHeader header;
+	memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+	header.version = kBinaryVersion;
+	header.hash = hashSources(vSource, fSource);
+	std::vector<char> binary(static_cast<size_t>(length));
+	GLsizei written = 0;
+	GLenum format = 0;
+	getProgramBinary(program, length, &written, &format, &binary[0]);
+	if (written <= 0) {
+		return;
+	}
+	header.format = format;
+	header.length = static_cast<uint32_t>(written);
+
+	// 先写临时文件再改名，程序中途退出时不会留下不完整的缓存
+	std::string path = makePath(header.hash);
+	std::string tempPath = path + ".tmp";
+	FILE* fp = openFile(tempPath, "wb");
+	if (fp == NULL) {
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(&binary[0], 1, header.length, fp) == header.length;
+	fclose(fp);
+	if (!ok || !renameFile(tempPath, path)) {
+		removeFile(tempPath);
+		return;
+	}
+	storeCount++;
+}
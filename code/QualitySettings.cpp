@@ -0,0 +1,262 @@
+#include "QualitySettings.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+
+static const char* kPresetNames[kQualityPresetCount] = { "low", "medium", "high" };
+
+static std::string trim(const std::string& text)
+{
+	size_t begin = 0;
+	size_t end = text.size();
+	while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+		begin++;
+	}
+	while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+		end--;
+	}
+	return text.substr(begin, end - begin);
+}
+
+static std::string toLower(std::string text)
+{
+	for (char& c : text) {
+		c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return text;
+}
+
+static bool parseBool(const std::string& value, bool& result)
+{
+	std::string lower = toLower(value);
+	if (lower == "1" || lower == "true" || lower == "on" || lower == "yes") {
+		result = true;
+		return true;
+	}
+	if (lower == "0" || lower == "false" || lower == "off" || lower == "no") {
+		result = false;
+		return true;
+	}
+	return false;
+}
+
+static bool parseInt(const std::string& value, int& result)
+{
+	char* end = NULL;
+	long parsed = std::strtol(value.c_str(), &end, 10);
+	if (end == value.c_str() || *end != '\0') {
+		return false;
+	}
+	result = static_cast<int>(parsed);
+	return true;
+}
+
+static bool parseFloat(const std::string& value, float& result)
+{
+	char* end = NULL;
+	float parsed = std::strtof(value.c_str(), &end);
+	if (end == value.c_str() || *end != '\0') {
+		return false;
+	}
+	result = parsed;
+	return true;
+}
+
+
+QualitySettings QualitySettings::fromPreset(QualityPreset preset)
+{
+	QualitySettings settings;
+	settings.preset = preset;
+	switch (preset) {
+	case kQualityLow:
+		// 软件光栅化的展台机器：片元开销为主，能省的都省
+		settings.crowdDensity = 0.4f;
+		settings.planarShadows = false;
+		settings.textureSize = 256;
+		settings.perPixelLighting = false;
+		settings.swimRingSegments = 8;
+		settings.depthPrepass = true;
+		settings.frontToBack = true;
+		settings.transparentDivisor = 4;
+		settings.dynamicResolution = true;
+		settings.minRenderScale = 0.5f;
+		break;
+	case kQualityMedium:
+		settings.crowdDensity = 0.7f;
+		settings.textureSize = 512;
+		settings.swimRingSegments = 12;
+		settings.depthPrepass = true;
+		settings.frontToBack = true;
+		settings.transparentDivisor = 2;
+		settings.dynamicResolution = true;
+		settings.minRenderScale = 0.75f;
+		break;
+	case kQualityHigh:
+	default:
+		break;
+	}
+	return settings;
+}
+
+const char* QualitySettings::getPresetName(QualityPreset preset)
+{
+	if (preset < 0 || preset >= kQualityPresetCount) {
+		return "unknown";
+	}
+	return kPresetNames[preset];
+}
+
+bool QualitySettings::parsePresetName(const std::string& name, QualityPreset& preset)
+{
+	std::string lower = toLower(trim(name));
+	for (int i = 0; i < kQualityPresetCount; i++) {
+		if (lower == kPresetNames[i]) {
+			preset = static_cast<QualityPreset>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool QualitySettings::load(const std::string& path, QualitySettings& settings)
+{
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	// 先全部读入，preset 不论写在哪一行都先应用
+	std::map<std::string, std::string> values;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+		line = trim(line);
+		if (line.empty()) {
+			continue;
+		}
+		size_t equals = line.find('=');
+		if (equals == std::string::npos) {
+			std::cerr << path << ":" << lineNumber << ": expected key = value" << std::endl;
+			continue;
+		}
+		values[toLower(trim(line.substr(0, equals)))] = trim(line.substr(equals + 1));
+	}
+
+	QualitySettings result = settings;
+	auto preset = values.find("preset");
+	if (preset != values.end()) {
+		QualityPreset parsed;
+		if (parsePresetName(preset->second, parsed)) {
+			result = fromPreset(parsed);
+		}
+		else {
+			std::cerr << path << ": unknown preset '" << preset->second << "'" << std::endl;
+		}
+		values.erase(preset);
+	}
+
+	for (const auto& entry : values) {
+		const std::string& key = entry.first;
+		const std::string& value = entry.second;
+		bool ok = false;
+		if (key == "crowd_density") {
+			ok = parseFloat(value, result.crowdDensity);
+		}
+		else if (key == "planar_shadows") {
+			ok = parseBool(value, result.planarShadows);
+		}
+		else if (key == "texture_size") {
+			ok = parseInt(value, result.textureSize);
+		}
+		else if (key == "per_pixel_lighting") {
+			ok = parseBool(value, result.perPixelLighting);
+		}
+		else if (key == "swim_ring_segments") {
+			ok = parseInt(value, result.swimRingSegments);
+		}
+		else if (key == "depth_prepass") {
+			ok = parseBool(value, result.depthPrepass);
+		}
+		else if (key == "front_to_back") {
+			ok = parseBool(value, result.frontToBack);
+		}
+		else if (key == "transparent_divisor") {
+			ok = parseInt(value, result.transparentDivisor);
+		}
+		else if (key == "dynamic_resolution") {
+			ok = parseBool(value, result.dynamicResolution);
+		}
+		else if (key == "min_render_scale") {
+			ok = parseFloat(value, result.minRenderScale);
+		}
+		else if (key == "max_render_scale") {
+			ok = parseFloat(value, result.maxRenderScale);
+		}
+		else if (key == "target_frame_time") {
+			ok = parseFloat(value, result.targetFrameTime);
+		}
+		else if (key == "idle_frame_rate") {
+			ok = parseFloat(value, result.idleFrameRate);
+		}
+		else if (key == "idle_delay") {
+			ok = parseFloat(value, result.idleDelay);
+		}
+		else {
+			std::cerr << path << ": unknown setting '" << key << "'" << std::endl;
+			continue;
+		}
+		if (!ok) {
+			std::cerr << path << ": invalid value '" << value << "' for " << key << std::endl;
+		}
+	}
+
+	result.clamp();
+	settings = result;
+	return true;
+}
+
+void QualitySettings::clamp()
+{
+	crowdDensity = std::min(std::max(crowdDensity, 0.0f), 1.0f);
+	// 纹理边长取不超过给定值的2的幂
+	int size = 64;
+	while (size * 2 <= std::min(textureSize, 4096)) {
+		size *= 2;
+	}
+	textureSize = size;
+	swimRingSegments = std::min(std::max(swimRingSegments, 3), 64);
+	transparentDivisor = transparentDivisor >= 4 ? 4 : (transparentDivisor >= 2 ? 2 : 1);
+	minRenderScale = std::min(std::max(minRenderScale, 0.25f), 1.0f);
+	maxRenderScale = std::min(std::max(maxRenderScale, minRenderScale), 1.0f);
+	targetFrameTime = std::max(targetFrameTime, 1.0f);
+	idleFrameRate = std::min(std::max(idleFrameRate, 0.0f), 60.0f);
+	idleDelay = std::max(idleDelay, 0.0f);
+}
+
+void QualitySettings::print(std::ostream& out) const
+{
+	out << "Quality preset: " << getPresetName(preset) << std::endl;
+	out << "  crowd density " << crowdDensity << ", planar shadows " << (planarShadows ? "on" : "off")
+		<< ", texture size " << textureSize << ", " << (perPixelLighting ? "per-pixel" : "per-vertex")
+		<< " lighting, swim ring segments " << swimRingSegments << std::endl;
+	out << "  depth pre-pass " << (depthPrepass ? "on" : "off") << ", front to back " << (frontToBack ? "on" : "off")
+		<< ", transparent 1/" << transparentDivisor << ", dynamic resolution " << (dynamicResolution ? "on" : "off")
+		<< " (" << minRenderScale << " - " << maxRenderScale << ", " << targetFrameTime << " ms)" << std::endl;
+	out << "  idle after " << idleDelay << " s, idle frame rate ";
+	if (idleFrameRate > 0.0f) {
+		out << idleFrameRate << " fps" << std::endl;
+	}
+	else {
+		out << "on input only" << std::endl;
+	}
+}
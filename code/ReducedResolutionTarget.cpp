@@ -0,0 +1,83 @@
+#include "ReducedResolutionTarget.h"
+
+
+static TransientTextureDesc makeDesc(int width, int height, GLenum internalFormat)
+{
+	TransientTextureDesc desc;
+	desc.width = width;
+	desc.height = height;
+	desc.internalFormat = internalFormat;
+	return desc;
+}
+
+
+ReducedResolutionTarget::ReducedResolutionTarget()
+	: divisor(1), width(0), height(0), lowWidth(0), lowHeight(0), sceneWidth(0), sceneHeight(0),
+	lowSceneWidth(0), lowSceneHeight(0)
+{
+}
+
+void ReducedResolutionTarget::setDivisor(int newDivisor)
+{
+	divisor = newDivisor < 1 ? 1 : newDivisor;
+	updateLowSize();
+}
+
+void ReducedResolutionTarget::resize(int newWidth, int newHeight)
+{
+	width = newWidth;
+	height = newHeight;
+	updateLowSize();
+}
+
+void ReducedResolutionTarget::setSceneSize(int newWidth, int newHeight)
+{
+	sceneWidth = newWidth;
+	sceneHeight = newHeight;
+	updateLowSize();
+}
+
+void ReducedResolutionTarget::updateLowSize()
+{
+	lowWidth = (width + divisor - 1) / divisor;
+	lowHeight = (height + divisor - 1) / divisor;
+	sceneWidth = sceneWidth < width ? sceneWidth : width;
+	sceneHeight = sceneHeight < height ? sceneHeight : height;
+	lowSceneWidth = (sceneWidth + divisor - 1) / divisor;
+	lowSceneHeight = (sceneHeight + divisor - 1) / divisor;
+}
+
+glm::vec2 ReducedResolutionTarget::getLowScale() const
+{
+	if (sceneWidth <= 0 || sceneHeight <= 0) {
+		return glm::vec2(1.0f / divisor);
+	}
+	return glm::vec2(static_cast<float>(lowSceneWidth) / sceneWidth, static_cast<float>(lowSceneHeight) / sceneHeight);
+}
+
+TransientTextureDesc ReducedResolutionTarget::getSceneDepthDesc() const
+{
+	return makeDesc(width, height, GL_DEPTH24_STENCIL8);
+}
+
+TransientTextureDesc ReducedResolutionTarget::getColorDesc() const
+{
+	return makeDesc(lowWidth, lowHeight, GL_RGBA8);
+}
+
+TransientTextureDesc ReducedResolutionTarget::getDepthDesc() const
+{
+	return makeDesc(lowWidth, lowHeight, GL_DEPTH24_STENCIL8);
+}
+
+void ReducedResolutionTarget::downsampleDepth(GLuint sceneFramebuffer, GLuint sceneDepthFramebuffer,
+	GLuint lowFramebuffer) const
+{
+	// 先原样复制场景深度，再最近点缩小到低分辨率；blit 不受深度写入开关影响
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneDepthFramebuffer);
+	glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, sceneWidth, sceneHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneDepthFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lowFramebuffer);
+	glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, lowSceneWidth, lowSceneHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+}
@@ -0,0 +1,105 @@
+#include "RenderQueue.h"
+
+
+// 粗略深度取深度的高几位，段数太多时程序和纹理的分组就被打散了
+static const int kCoarseDepthBits = 6;
+
+
+RenderQueue::RenderQueue() : opaqueOrder(kOpaqueOrderState)
+{
+}
+
+void RenderQueue::clear()
+{
+	// 只清空内容，保留容量，避免每帧重新分配
+	packets.clear();
+	order.clear();
+}
+
+DrawPacket& RenderQueue::push(const DrawPacket& packet)
+{
+	packets.push_back(packet);
+	return packets.back();
+}
+
+void RenderQueue::append(const RenderQueue& other)
+{
+	packets.insert(packets.end(), other.packets.begin(), other.packets.end());
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, GLuint texture, float depth01)
+{
+	if (depth01 < 0.0f) {
+		depth01 = 0.0f;
+	}
+	if (depth01 > 1.0f) {
+		depth01 = 1.0f;
+	}
+	const uint64_t depthMax = (1u << 24) - 1u;
+	uint64_t depth = static_cast<uint64_t>(depth01 * static_cast<float>(depthMax));
+	uint64_t programBits = static_cast<uint64_t>(program & 0x3FFu);
+	uint64_t textureBits = static_cast<uint64_t>(texture & 0x3FFu);
+	uint64_t key = static_cast<uint64_t>(pass & 0xF) << 60;
+
+	if (pass == kPassTransparent) {
+		key |= (depthMax - depth) << 36;
+		key |= programBits << 26;
+		key |= textureBits << 16;
+	}
+	else {
+		key |= programBits << 50;
+		key |= textureBits << 40;
+		key |= depth << 16;
+	}
+	return key;
+}
+
+uint64_t RenderQueue::makeFrontToBackKey(uint64_t key)
+{
+	uint64_t pass = key >> 60;
+	uint64_t programBits = (key >> 50) & 0x3FFu;
+	uint64_t textureBits = (key >> 40) & 0x3FFu;
+	uint64_t depth = (key >> 16) & 0xFFFFFFu;
+	uint64_t coarseDepth = depth >> (24 - kCoarseDepthBits);
+	return (pass << 60) | (coarseDepth << 54) | (programBits << 44) | (textureBits << 34) | (depth << 10);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = packets.size();
+	keys.resize(count);
+	order.resize(count);
+	keysTemp.resize(count);
+	orderTemp.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		keys[i] = packets[i].key;
+		if (opaqueOrder == kOpaqueOrderFrontToBack && packets[i].pass == kPassOpaque) {
+			keys[i] = makeFrontToBackKey(keys[i]);
+		}
+		order[i] = static_cast<uint32_t>(i);
+	}
+
+	// LSD基数排序，每次处理8位；所有键在该字节上相同时跳过这一趟
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t histogram[256] = { 0 };
+		for (size_t i = 0; i < count; i++) {
+			histogram[(keys[i] >> shift) & 0xFF]++;
+		}
+		if (count == 0 || histogram[(keys[0] >> shift) & 0xFF] == count) {
+			continue;
+		}
+		size_t offsets[256];
+		size_t sum = 0;
+		for (int b = 0; b < 256; b++) {
+			offsets[b] = sum;
+			sum += histogram[b];
+		}
+		for (size_t i = 0; i < count; i++) {
+			size_t dst = offsets[(keys[i] >> shift) & 0xFF]++;
+			keysTemp[dst] = keys[i];
+			orderTemp[dst] = order[i];
+		}
+		keys.swap(keysTemp);
+		order.swap(orderTemp);
+	}
+}
@@ -0,0 +1,367 @@
+#include "ShaderCache.h"
+
+#include <fstream>
+#include <sstream>
+
+
+// GL 4.3 的枚举值，3.3 的头文件中没有
+static const GLenum kComputeShader = 0x91B9;
+
+// 把宏定义插入到 #version 行之后，GLSL 要求 #version 必须在最前面
+static std::string injectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty()) {
+		return source;
+	}
+	size_t versionPos = source.find("#version");
+	if (versionPos == std::string::npos) {
+		return defines + "\n" + source;
+	}
+	size_t lineEnd = source.find('\n', versionPos);
+	if (lineEnd == std::string::npos) {
+		return source + "\n" + defines + "\n";
+	}
+	return source.substr(0, lineEnd + 1) + defines + "\n" + source.substr(lineEnd + 1);
+}
+
+
+bool ShaderProgram::check(UniformSlot slot, GLenum type) const
+{
+	(void)type;
+	if (!reflection.has(slot)) {
+		return false;
+	}
+#ifdef DEBUG
+	// 采样器和 int 使用同一个上传函数
+	GLenum actual = reflection.getType(slot);
+	bool matches = actual == type || (type == GL_INT && actual == GL_SAMPLER_2D);
+	if (!matches) {
+		std::cerr << "Uniform " << ShaderReflection::getSlotName(slot) << " type mismatch" << std::endl;
+		return false;
+	}
+#endif
+	return true;
+}
+
+void ShaderProgram::set(UniformSlot slot, int value) const
+{
+	if (check(slot, GL_INT)) {
+		glUniform1i(reflection.getLocation(slot), value);
+	}
+}
+
+void ShaderProgram::set(UniformSlot slot, float value) const
+{
+	if (check(slot, GL_FLOAT)) {
+		glUniform1f(reflection.getLocation(slot), value);
+	}
+}
+
+void ShaderProgram::set(UniformSlot slot, const glm::vec2& value) const
+{
+	if (check(slot, GL_FLOAT_VEC2)) {
+		glUniform2fv(reflection.getLocation(slot), 1, &value[0]);
+	}
+}
+
+void ShaderProgram::set(UniformSlot slot, const glm::vec3& value) const
+{
+	if (check(slot, GL_FLOAT_VEC3)) {
+		glUniform3fv(reflection.getLocation(slot), 1, &value[0]);
+	}
+}
+
+void ShaderProgram::set(UniformSlot slot, const glm::vec4& value) const
+{
+	if (check(slot, GL_FLOAT_VEC4)) {
+		glUniform4fv(reflection.getLocation(slot), 1, &value[0]);
+	}
+}
+
+void ShaderProgram::set(UniformSlot slot, const glm::mat4& value) const
+{
+	if (check(slot, GL_FLOAT_MAT4)) {
+		glUniformMatrix4fv(reflection.getLocation(slot), 1, GL_FALSE, &value[0][0]);
+	}
+}
+
+
+ShaderCache::ShaderCache() : binaryCache(NULL), hitCount(0)
+{
+}
+
+ShaderCache::~ShaderCache()
+{
+	// 程序对象由 clear() 在上下文销毁前释放，这里只回收CPU端内存
+	for (auto& entry : programs) {
+		delete entry.second;
+	}
+	programs.clear();
+	for (auto& entry : variantSets) {
+		delete entry.second;
+	}
+	variantSets.clear();
+}
+
+const std::string& ShaderCache::readSource(const std::string& filename, bool required)
+{
+	static const std::string empty;
+	auto found = sources.find(filename);
+	if (found != sources.end()) {
+		return found->second;
+	}
+	std::ifstream fin(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!fin) {
+		std::cerr << "Failed to read " << filename << std::endl;
+		if (!required) {
+			return empty;
+		}
+		exit(EXIT_FAILURE);
+	}
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return sources[filename] = ss.str();
+}
+
+ShaderProgram* ShaderCache::getProgram(const std::string& vshader, const std::string& fshader,
+	const std::string& defines)
+{
+	std::string vSource = injectDefines(readSource(vshader), defines);
+	std::string fSource = injectDefines(readSource(fshader), defines);
+
+	// 以展开后的源码为键，文件不同但内容相同的着色器也会共享同一个程序
+	std::string key = vSource;
+	key += '\0';
+	key += fSource;
+
+	auto found = programs.find(key);
+	if (found != programs.end()) {
+		hitCount++;
+		return found->second;
+	}
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	ShaderProgram* shader = new ShaderProgram();
+	if (binaryCache != NULL) {
+		shader->program = binaryCache->load(vSource, fSource);
+	}
+	if (shader->program == 0) {
+		// 要保存到缓存的程序在链接前创建，以便设置可取回二进制的提示
+		GLuint program = binaryCache != NULL ? binaryCache->createProgram() : 0;
+		shader->program = InitShaderFromSource(vSource.c_str(), fSource.c_str(), vshader.c_str(), fshader.c_str(),
+			program);
+		if (binaryCache != NULL) {
+			binaryCache->store(shader->program, vSource, fSource);
+		}
+	}
+	// InitShaderFromSource 会直接使用新程序；从二进制恢复的程序丢失了 uniform 的设置，
+	// 由 applyBindings 重新设置
+	glUseProgram(static_cast<GLuint>(previous));
+	applyBindings(shader->program);
+	shader->reflection.reflect(shader->program);
+	programs[key] = shader;
+	return shader;
+}
+
+ShaderProgram* ShaderCache::getComputeProgram(const std::string& cshader, const std::string& defines)
+{
+	const std::string& file = readSource(cshader, false);
+	if (file.empty()) {
+		return NULL;
+	}
+	std::string source = injectDefines(file, defines);
+	// 与顶点、片元程序的键区分开
+	std::string key = "compute";
+	key += '\0';
+	key += source;
+
+	auto found = programs.find(key);
+	if (found != programs.end()) {
+		hitCount++;
+		return found->second;
+	}
+
+	const GLchar* text = source.c_str();
+	GLuint shader = glCreateShader(kComputeShader);
+	glShaderSource(shader, 1, &text, NULL);
+	glCompileShader(shader);
+	GLint compiled = 0;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled) {
+		GLint logSize = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logSize);
+		std::string log(logSize > 0 ? logSize : 1, '\0');
+		glGetShaderInfoLog(shader, logSize, NULL, &log[0]);
+		std::cerr << cshader << " failed to compile:" << std::endl << log << std::endl;
+		glDeleteShader(shader);
+		return NULL;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		GLint logSize = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
+		std::string log(logSize > 0 ? logSize : 1, '\0');
+		glGetProgramInfoLog(program, logSize, NULL, &log[0]);
+		std::cerr << cshader << " failed to link:" << std::endl << log << std::endl;
+		glDeleteProgram(program);
+		return NULL;
+	}
+
+	ShaderProgram* computeProgram = new ShaderProgram();
+	computeProgram->program = program;
+	applyBindings(program);
+	computeProgram->reflection.reflect(program);
+	programs[key] = computeProgram;
+	return computeProgram;
+}
+
+void ShaderCache::applyBindings(GLuint program)
+{
+	// uniform block 绑定点和采样器单元只在链接后设置一次，绘制时无需再上传
+	for (const auto& binding : blockBindings) {
+		GLuint blockIndex = glGetUniformBlockIndex(program, binding.first.c_str());
+		if (blockIndex != GL_INVALID_INDEX) {
+			glUniformBlockBinding(program, blockIndex, binding.second);
+		}
+	}
+	// 设置采样器需要临时使用新程序，之后恢复原来的程序，调用者记录的GL状态仍然有效
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+	for (const auto& sampler : samplerUnits) {
+		GLint location = glGetUniformLocation(program, sampler.first.c_str());
+		if (location != -1) {
+			glUniform1i(location, sampler.second);
+		}
+	}
+	glUseProgram(static_cast<GLuint>(previous));
+}
+
+void ShaderCache::setBinaryCache(ProgramBinaryCache* cache)
+{
+	binaryCache = cache;
+}
+
+void ShaderCache::bindUniformBlock(const std::string& blockName, GLuint binding)
+{
+	blockBindings[blockName] = binding;
+}
+
+void ShaderCache::bindSampler(const std::string& samplerName, GLint unit)
+{
+	samplerUnits[samplerName] = unit;
+}
+
+ShaderVariants* ShaderCache::getVariants(const std::string& vshader, const std::string& fshader)
+{
+	std::string key = vshader;
+	key += '\0';
+	key += fshader;
+	auto found = variantSets.find(key);
+	if (found != variantSets.end()) {
+		return found->second;
+	}
+	ShaderVariants* variants = new ShaderVariants(this, vshader, fshader);
+	variantSets[key] = variants;
+	return variants;
+}
+
+void ShaderCache::clear()
+{
+	for (auto& entry : programs) {
+		glDeleteProgram(entry.second->program);
+		delete entry.second;
+	}
+	programs.clear();
+	for (auto& entry : variantSets) {
+		delete entry.second;
+	}
+	variantSets.clear();
+	sources.clear();
+	hitCount = 0;
+}
+
+int ShaderCache::getProgramCount() const
+{
+	return static_cast<int>(programs.size());
+}
+
+int ShaderCache::getHitCount() const
+{
+	return hitCount;
+}
+
+
+ShaderVariants::ShaderVariants(ShaderCache* shaderCache, const std::string& vertexShader, const std::string& fragmentShader)
+	: cache(shaderCache), vshader(vertexShader), fshader(fragmentShader)
+{
+	for (int i = 0; i < kShaderVariantCount; i++) {
+		variants[i] = NULL;
+	}
+}
+
+unsigned int ShaderVariants::normalize(unsigned int features)
+{
+	if (features & kShaderShadowOnly) {
+		features &= kShaderShadowOnly | kShaderCrowdInstancing;
+	}
+	if (features & kShaderDepthOnly) {
+		features &= kShaderDepthOnly | kShaderCrowdInstancing;
+	}
+	if (!(features & kShaderTexture)) {
+		features &= ~kShaderTriplanar;
+	}
+	if (!(features & kShaderLighting)) {
+		features &= ~kShaderVertexLighting;
+	}
+	return features & (kShaderVariantCount - 1);
+}
+
+std::string ShaderVariants::getDefines(unsigned int features)
+{
+	std::string defines;
+	if (features & kShaderShadowOnly) {
+		defines += "#define SHADOW_ONLY\n";
+	}
+	if (features & kShaderTexture) {
+		defines += "#define USE_TEXTURE\n";
+	}
+	if (features & kShaderLighting) {
+		defines += "#define USE_LIGHTING\n";
+	}
+	if (features & kShaderCrowdInstancing) {
+		defines += "#define CROWD_INSTANCING\n";
+	}
+	if (features & kShaderTriplanar) {
+		defines += "#define TRIPLANAR\n";
+	}
+	if (features & kShaderDepthOnly) {
+		defines += "#define DEPTH_ONLY\n";
+	}
+	if (features & kShaderVertexLighting) {
+		defines += "#define VERTEX_LIGHTING\n";
+	}
+	return defines;
+}
+
+ShaderProgram* ShaderVariants::get(unsigned int features)
+{
+	features = normalize(features);
+	ShaderProgram*& variant = variants[features];
+	if (variant == NULL) {
+		variant = cache->getProgram(vshader, fshader, getDefines(features));
+	}
+	return variant;
+}
+
+ShaderProgram* ShaderVariants::find(unsigned int features) const
+{
+	return variants[normalize(features)];
+}
@@ -0,0 +1,108 @@
+#include "ShaderReflection.h"
+
+
+// 与 UniformSlot 的顺序一一对应
+static const char* kUniformNames[kUniformSlotCount] = {
+	"model",
+	"shadowAlpha",
+	"colorTint",
+	"alpha",
+	"texScale",
+	"texOffset",
+
+	"crowdTime",
+	"crowdTarget",
+	"partPivot",
+	"partChildOffset",
+	"partSwing",
+	"partLocal",
+
+	"transparentScale",
+	"transparentSize"
+};
+
+static std::string stripArraySuffix(const std::string& name)
+{
+	size_t length = name.size();
+	if (length > 3 && name.compare(length - 3, 3, "[0]") == 0) {
+		return name.substr(0, length - 3);
+	}
+	return name;
+}
+
+static const ShaderVariable* findVariable(const std::vector<ShaderVariable>& variables, const std::string& name)
+{
+	for (const auto& variable : variables) {
+		if (variable.name == name) {
+			return &variable;
+		}
+	}
+	return NULL;
+}
+
+
+ShaderReflection::ShaderReflection()
+{
+	for (int i = 0; i < kUniformSlotCount; i++) {
+		slots[i] = -1;
+		slotTypes[i] = 0;
+	}
+}
+
+void ShaderReflection::reflect(GLuint program)
+{
+	uniforms.clear();
+	attributes.clear();
+
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name(static_cast<size_t>(maxLength > 0 ? maxLength : 1));
+	for (GLint i = 0; i < count; i++) {
+		ShaderVariable variable;
+		GLsizei length = 0;
+		glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length,
+			&variable.size, &variable.type, &name[0]);
+		variable.name = stripArraySuffix(std::string(&name[0], length));
+		variable.location = glGetUniformLocation(program, &name[0]);
+		// uniform block 中的成员没有位置，由 uniform buffer 提供
+		if (variable.location != -1) {
+			uniforms.push_back(variable);
+		}
+	}
+
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(static_cast<size_t>(maxLength > 0 ? maxLength : 1));
+	for (GLint i = 0; i < count; i++) {
+		ShaderVariable variable;
+		GLsizei length = 0;
+		glGetActiveAttrib(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length,
+			&variable.size, &variable.type, &name[0]);
+		variable.name = stripArraySuffix(std::string(&name[0], length));
+		variable.location = glGetAttribLocation(program, &name[0]);
+		attributes.push_back(variable);
+	}
+
+	for (int i = 0; i < kUniformSlotCount; i++) {
+		const ShaderVariable* variable = findUniform(kUniformNames[i]);
+		slots[i] = variable ? variable->location : -1;
+		slotTypes[i] = variable ? variable->type : 0;
+	}
+}
+
+const ShaderVariable* ShaderReflection::findUniform(const std::string& name) const
+{
+	return findVariable(uniforms, name);
+}
+
+const ShaderVariable* ShaderReflection::findAttribute(const std::string& name) const
+{
+	return findVariable(attributes, name);
+}
+
+const char* ShaderReflection::getSlotName(UniformSlot slot)
+{
+	return kUniformNames[slot];
+}
@@ -0,0 +1,154 @@
+#include "SkyboxCubemap.h"
+#include "stb_image.h"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+
+const CubemapGridLayout kCubemapCrossLayout = {
+	4, 3,
+	{ { 2, 1 }, { 0, 1 }, { 1, 0 }, { 1, 2 }, { 1, 1 }, { 3, 1 } }
+};
+
+const CubemapGridLayout kCubemapGrid3x2Layout = {
+	3, 2,
+	{ { 0, 0 }, { 1, 0 }, { 2, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 } }
+};
+
+// 立方体贴图的第一行是面的上边，不能按全局设置翻转；只修改工作线程自己的设置
+static bool decodeImage(const std::string& path, int& width, int& height, int& channels, std::vector<unsigned char>& pixels)
+{
+	stbi_set_flip_vertically_on_load_thread(0);
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+	if (!data) {
+		return false;
+	}
+	pixels.assign(data, data + static_cast<size_t>(width) * height * channels);
+	stbi_image_free(data);
+	return true;
+}
+
+
+SkyboxCubemap::SkyboxCubemap() : texture(0), faceSize(0)
+{
+}
+
+bool SkyboxCubemap::loadFaces(const std::string paths[kCubeFaceCount])
+{
+	FaceImage faces[kCubeFaceCount];
+	bool loaded[kCubeFaceCount] = { false };
+	std::vector<std::thread> workers;
+	for (int i = 0; i < kCubeFaceCount; i++) {
+		workers.push_back(std::thread([&, i]() {
+			FaceImage& face = faces[i];
+			loaded[i] = decodeImage(paths[i], face.width, face.height, face.channels, face.pixels);
+		}));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	for (int i = 0; i < kCubeFaceCount; i++) {
+		if (!loaded[i]) {
+			std::cerr << "Failed to load skybox face: " << paths[i] << std::endl;
+			return false;
+		}
+	}
+	return upload(faces);
+}
+
+bool SkyboxCubemap::loadGrid(const std::string& path, const CubemapGridLayout& layout)
+{
+	// 解码也放在工作线程中，调用线程的翻转设置保持不变
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+	bool loaded = false;
+	std::thread decoder([&]() {
+		loaded = decodeImage(path, width, height, channels, pixels);
+	});
+	decoder.join();
+	if (!loaded) {
+		std::cerr << "Failed to load skybox: " << path << std::endl;
+		return false;
+	}
+
+	int cellWidth = width / layout.columns;
+	int cellHeight = height / layout.rows;
+	if (cellWidth == 0 || cellWidth != cellHeight) {
+		std::cerr << "Skybox " << path << " (" << width << "x" << height << ") does not match a "
+			<< layout.columns << "x" << layout.rows << " grid of square faces" << std::endl;
+		return false;
+	}
+
+	// 每个面在一个工作线程中逐行复制出来
+	FaceImage faces[kCubeFaceCount];
+	std::vector<std::thread> workers;
+	size_t rowBytes = static_cast<size_t>(cellWidth) * channels;
+	for (int i = 0; i < kCubeFaceCount; i++) {
+		workers.push_back(std::thread([&, i]() {
+			FaceImage& face = faces[i];
+			face.width = cellWidth;
+			face.height = cellHeight;
+			face.channels = channels;
+			face.pixels.resize(rowBytes * cellHeight);
+			size_t left = static_cast<size_t>(layout.cells[i][0]) * cellWidth;
+			size_t top = static_cast<size_t>(layout.cells[i][1]) * cellHeight;
+			for (int y = 0; y < cellHeight; y++) {
+				const unsigned char* source = &pixels[((top + y) * width + left) * channels];
+				memcpy(&face.pixels[y * rowBytes], source, rowBytes);
+			}
+		}));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	return upload(faces);
+}
+
+bool SkyboxCubemap::upload(const FaceImage faces[kCubeFaceCount])
+{
+	int size = faces[0].width;
+	for (int i = 0; i < kCubeFaceCount; i++) {
+		if (faces[i].width != size || faces[i].height != size) {
+			std::cerr << "Skybox faces must be square and the same size" << std::endl;
+			return false;
+		}
+	}
+
+	if (texture == 0) {
+		glGenTextures(1, &texture);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < kCubeFaceCount; i++) {
+		const FaceImage& face = faces[i];
+		GLenum format = GL_RGB;
+		if (face.channels == 1) {
+			format = GL_RED;
+		}
+		else if (face.channels == 4) {
+			format = GL_RGBA;
+		}
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, size, size, 0, format,
+			GL_UNSIGNED_BYTE, &face.pixels[0]);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	faceSize = size;
+	return true;
+}
+
+void SkyboxCubemap::clear()
+{
+	if (texture != 0) {
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+	faceSize = 0;
+}
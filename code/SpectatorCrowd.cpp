@@ -0,0 +1,108 @@
+#include "SpectatorCrowd.h"
+
+#include <cstddef>
+
+
+SpectatorCrowd::SpectatorCrowd() : instanceBuffer(0), instanceCount(0), time(0.0f), target(0.0f)
+{
+}
+
+SpectatorCrowd::~SpectatorCrowd()
+{
+}
+
+int SpectatorCrowd::addPart(const GeometryHandle* geometry, const glm::vec3& pivot, const glm::vec3& childOffset,
+	const glm::vec2& swing, const glm::mat4& local)
+{
+	CrowdPart part;
+	part.geometry = geometry;
+	part.pivot = pivot;
+	part.childOffset = childOffset;
+	part.swing = swing;
+	part.local = local;
+	if (instanceBuffer != 0) {
+		part.vao = createVertexArray(part, instanceBuffer);
+	}
+	parts.push_back(part);
+	return static_cast<int>(parts.size()) - 1;
+}
+
+GLuint SpectatorCrowd::createVertexArray(const CrowdPart& part, GLuint buffer)
+{
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	// 几何属性直接引用注册表中的顶点缓存，不复制顶点数据
+	GeometryRegistry::bindAttributes(part.geometry);
+
+	// 实例属性每个实例前进一次
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableVertexAttribArray(kInstancePositionAttrib);
+	glVertexAttribPointer(kInstancePositionAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance),
+		BUFFER_OFFSET(offsetof(CrowdInstance, positionScale)));
+	glVertexAttribDivisor(kInstancePositionAttrib, 1);
+	glEnableVertexAttribArray(kInstanceTintAttrib);
+	glVertexAttribPointer(kInstanceTintAttrib, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance),
+		BUFFER_OFFSET(offsetof(CrowdInstance, tintPhase)));
+	glVertexAttribDivisor(kInstanceTintAttrib, 1);
+
+	glBindVertexArray(0);
+	return vao;
+}
+
+GLuint SpectatorCrowd::createInstanceVertexArray(int index, GLuint buffer) const
+{
+	return createVertexArray(parts[index], buffer);
+}
+
+void SpectatorCrowd::setInstances(const std::vector<CrowdInstance>& instances)
+{
+	bool created = instanceBuffer == 0;
+	if (created) {
+		glGenBuffers(1, &instanceBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CrowdInstance),
+		instances.empty() ? NULL : &instances[0], GL_STATIC_DRAW);
+	instanceCount = static_cast<GLsizei>(instances.size());
+
+	// 顶点数组对象记录的是缓存对象而不是数据，重新上传时不需要重建
+	if (created) {
+		for (auto& part : parts) {
+			part.vao = createVertexArray(part, instanceBuffer);
+		}
+	}
+}
+
+void SpectatorCrowd::setFrame(float frameTime, const glm::vec3& frameTarget)
+{
+	time = frameTime;
+	target = frameTarget;
+}
+
+void SpectatorCrowd::applyPart(const ShaderProgram* shader, int index) const
+{
+	const CrowdPart& part = parts[index];
+	shader->set(kUniformCrowdTime, time);
+	shader->set(kUniformCrowdTarget, target);
+	shader->set(kUniformPartPivot, part.pivot);
+	shader->set(kUniformPartChildOffset, part.childOffset);
+	shader->set(kUniformPartSwing, part.swing);
+	shader->set(kUniformPartLocal, part.local);
+}
+
+void SpectatorCrowd::clear()
+{
+	for (auto& part : parts) {
+		if (part.vao != 0) {
+			glDeleteVertexArrays(1, &part.vao);
+		}
+	}
+	parts.clear();
+	if (instanceBuffer != 0) {
+		glDeleteBuffers(1, &instanceBuffer);
+		instanceBuffer = 0;
+	}
+	instanceCount = 0;
+}
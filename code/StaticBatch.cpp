@@ -0,0 +1,184 @@
+#include "StaticBatch.h"
+#include "GeometryRegistry.h"
+
+
+StaticBatch::StaticBatch() : vao(0), positionVao(0), vbo(0), sourceDrawCount(0), bufferBytes(0), built(false),
+	vertexPacking(kVertexPackingFloat)
+{
+}
+
+StaticBatch::~StaticBatch()
+{
+}
+
+void StaticBatch::begin()
+{
+	clear();
+}
+
+bool StaticBatch::sameMaterial(const DrawPacket& a, const DrawPacket& b)
+{
+	// 颜色、纹理缩放和偏移、材质下标、纹理层已经写进顶点，不影响分组；
+	// 三向投影按世界坐标采样，纹理缩放和偏移仍是 uniform，必须相同
+	return a.pass == b.pass &&
+		a.shader == b.shader &&
+		a.useTexture == b.useTexture &&
+		a.textureID == b.textureID &&
+		a.useTriplanar == b.useTriplanar &&
+		(a.useTriplanar == 0 || (a.texScale == b.texScale && a.texOffset == b.texOffset)) &&
+		a.colorTint == b.colorTint &&
+		a.alpha == b.alpha &&
+		a.shadowAlpha == b.shadowAlpha &&
+		a.useLighting == b.useLighting;
+}
+
+StaticBatch::Group& StaticBatch::findGroup(const DrawPacket& packet)
+{
+	for (auto& group : groups) {
+		if (sameMaterial(group.packet, packet)) {
+			return group;
+		}
+	}
+	groups.push_back(Group());
+	Group& group = groups.back();
+	group.packet = packet;
+	group.packet.model = glm::mat4(1.0f);
+	group.packet.color = glm::vec3(1.0f, 1.0f, 1.0f);
+	if (packet.useTriplanar == 0) {
+		group.packet.texScale = glm::vec2(1.0f, 1.0f);
+		group.packet.texOffset = glm::vec2(0.0f, 0.0f);
+	}
+	group.packet.materialIndex = 0;
+	group.packet.textureLayer = 0;
+	return group;
+}
+
+void StaticBatch::add(const DrawPacket& packet, TriMesh* mesh)
+{
+	Group& group = findGroup(packet);
+	sourceDrawCount++;
+
+	std::vector<glm::vec3> points = mesh->getPoints();
+	std::vector<glm::vec3> colors = mesh->getColors();
+	std::vector<glm::vec3> normals = mesh->getNormals();
+	std::vector<glm::vec2> texcoords = mesh->getTexCoords();
+	std::vector<GLuint> indices = mesh->getIndices();
+
+	// 合批缓存按顶点顺序绘制，索引网格在这里展开
+	if (indices.empty()) {
+		for (size_t i = 0; i < points.size(); i++) {
+			indices.push_back(static_cast<GLuint>(i));
+		}
+	}
+
+	const glm::mat4& model = packet.model;
+	for (size_t n = 0; n < indices.size(); n++) {
+		size_t i = indices[n];
+		// 阴影的投影矩阵会改变 w，这里和顶点着色器一样做透视除法
+		glm::vec4 position = model * glm::vec4(points[i], 1.0f);
+		group.points.push_back(glm::vec3(position) / position.w);
+
+		group.colors.push_back(i < colors.size() ? colors[i] : packet.color);
+
+		glm::vec3 normal = i < normals.size() ? normals[i] : glm::vec3(0.0f, 1.0f, 0.0f);
+		normal = glm::vec3(model * glm::vec4(normal, 0.0f));
+		if (glm::length(normal) > 1e-6f) {
+			normal = glm::normalize(normal);
+		}
+		group.normals.push_back(normal);
+
+		glm::vec2 texcoord = i < texcoords.size() ? texcoords[i] : glm::vec2(0.0f, 0.0f);
+		group.texcoords.push_back(packet.useTriplanar == 0 ? texcoord * packet.texScale + packet.texOffset : texcoord);
+		group.materials.push_back(packet.materialIndex);
+		group.layers.push_back(packet.textureLayer);
+	}
+}
+
+void StaticBatch::end()
+{
+	// 所有材质组共用一个交错缓存，组之间用 first/count 区分
+	std::vector<glm::vec3> points;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texcoords;
+	std::vector<GLint> materials;
+	std::vector<GLint> layers;
+	for (auto& group : groups) {
+		group.geometry.first = static_cast<GLint>(points.size());
+		group.geometry.count = static_cast<GLsizei>(group.points.size());
+		points.insert(points.end(), group.points.begin(), group.points.end());
+		colors.insert(colors.end(), group.colors.begin(), group.colors.end());
+		normals.insert(normals.end(), group.normals.begin(), group.normals.end());
+		texcoords.insert(texcoords.end(), group.texcoords.begin(), group.texcoords.end());
+		materials.insert(materials.end(), group.materials.begin(), group.materials.end());
+		layers.insert(layers.end(), group.layers.begin(), group.layers.end());
+
+		// 合并之后不再需要各组的顶点
+		std::vector<glm::vec3>().swap(group.points);
+		std::vector<glm::vec3>().swap(group.colors);
+		std::vector<glm::vec3>().swap(group.normals);
+		std::vector<glm::vec2>().swap(group.texcoords);
+		std::vector<GLint>().swap(group.materials);
+		std::vector<GLint>().swap(group.layers);
+	}
+	if (points.empty()) {
+		built = true;
+		return;
+	}
+
+	// 不同材质、不同纹理层的物体合并在同一组中，材质下标和纹理层作为逐顶点的整数属性
+	VertexStreams streams;
+	streams.points = &points;
+	streams.colors = &colors;
+	streams.normals = &normals;
+	streams.texcoords = &texcoords;
+	streams.materials = &materials;
+	streams.layers = &layers;
+	VertexFormat format = VertexFormat::choose(streams, vertexPacking);
+	std::vector<unsigned char> vertices = format.pack(streams);
+	bufferBytes = vertices.size();
+
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, bufferBytes, &vertices[0], GL_STATIC_DRAW);
+	format.bind(static_cast<GLsizei>(points.size()));
+
+	glGenVertexArrays(1, &positionVao);
+	glBindVertexArray(positionVao);
+	format.bindPositions();
+	glBindVertexArray(0);
+
+	for (auto& group : groups) {
+		group.geometry.vao = vao;
+		group.geometry.positionVao = positionVao;
+		group.geometry.vbo = vbo;
+		group.geometry.vertexCount = static_cast<GLsizei>(points.size());
+		group.geometry.hasVertexColor = true;
+		group.geometry.format = format;
+		group.geometry.refCount = 1;
+		group.packet.geometry = &group.geometry;
+	}
+	built = true;
+}
+
+void StaticBatch::clear()
+{
+	if (vbo != 0) {
+		glDeleteBuffers(1, &vbo);
+		vbo = 0;
+	}
+	if (vao != 0) {
+		glDeleteVertexArrays(1, &vao);
+		vao = 0;
+	}
+	if (positionVao != 0) {
+		glDeleteVertexArrays(1, &positionVao);
+		positionVao = 0;
+	}
+	groups.clear();
+	sourceDrawCount = 0;
+	bufferBytes = 0;
+	built = false;
+}
@@ -0,0 +1,110 @@
+#include "TextureArray.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// 读取一个像素并扩展为 RGBA
+static void fetchTexel(const unsigned char* pixels, int width, int channels, int x, int y, float* rgba)
+{
+	const unsigned char* texel = pixels + (static_cast<size_t>(y) * width + x) * channels;
+	if (channels >= 3) {
+		rgba[0] = texel[0];
+		rgba[1] = texel[1];
+		rgba[2] = texel[2];
+		rgba[3] = channels == 4 ? texel[3] : 255.0f;
+	}
+	else {
+		rgba[0] = rgba[1] = rgba[2] = texel[0];
+		rgba[3] = channels == 2 ? texel[1] : 255.0f;
+	}
+}
+
+
+TextureArray::TextureArray(GLsizei layerWidth, GLsizei layerHeight)
+	: width(layerWidth), height(layerHeight), layerCount(0), texture(0)
+{
+}
+
+int TextureArray::addLayer(const unsigned char* source, int sourceWidth, int sourceHeight, int channels)
+{
+	size_t layerSize = static_cast<size_t>(width) * height * 4;
+	size_t base = pixels.size();
+	pixels.resize(base + layerSize);
+	unsigned char* layer = &pixels[base];
+
+	// 按像素中心对齐的双线性采样；尺寸相同时正好取到原像素
+	float scaleX = static_cast<float>(sourceWidth) / width;
+	float scaleY = static_cast<float>(sourceHeight) / height;
+	for (int y = 0; y < height; y++) {
+		float sy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), static_cast<float>(sourceHeight - 1));
+		int y0 = static_cast<int>(sy);
+		int y1 = std::min(y0 + 1, sourceHeight - 1);
+		float fy = sy - y0;
+		for (int x = 0; x < width; x++) {
+			float sx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), static_cast<float>(sourceWidth - 1));
+			int x0 = static_cast<int>(sx);
+			int x1 = std::min(x0 + 1, sourceWidth - 1);
+			float fx = sx - x0;
+
+			float c00[4], c10[4], c01[4], c11[4];
+			fetchTexel(source, sourceWidth, channels, x0, y0, c00);
+			fetchTexel(source, sourceWidth, channels, x1, y0, c10);
+			fetchTexel(source, sourceWidth, channels, x0, y1, c01);
+			fetchTexel(source, sourceWidth, channels, x1, y1, c11);
+			unsigned char* texel = layer + (static_cast<size_t>(y) * width + x) * 4;
+			for (int k = 0; k < 4; k++) {
+				float top = c00[k] + (c10[k] - c00[k]) * fx;
+				float bottom = c01[k] + (c11[k] - c01[k]) * fx;
+				texel[k] = static_cast<unsigned char>(std::floor(top + (bottom - top) * fy + 0.5f));
+			}
+		}
+	}
+	return layerCount++;
+}
+
+void TextureArray::reset(GLsizei layerWidth, GLsizei layerHeight)
+{
+	width = layerWidth;
+	height = layerHeight;
+	std::vector<unsigned char>().swap(pixels);
+	layerCount = 0;
+}
+
+GLuint TextureArray::upload()
+{
+	if (layerCount == 0) {
+		return 0;
+	}
+	if (texture == 0) {
+		glGenTextures(1, &texture);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layerCount, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	std::vector<unsigned char>().swap(pixels);
+	return texture;
+}
+
+size_t TextureArray::getTextureBytes() const
+{
+	// 加上mipmap约为基础层的4/3
+	return static_cast<size_t>(width) * height * 4 * layerCount * 4 / 3;
+}
+
+void TextureArray::clear()
+{
+	if (texture != 0) {
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+	std::vector<unsigned char>().swap(pixels);
+	layerCount = 0;
+}
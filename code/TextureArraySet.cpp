@@ -0,0 +1,109 @@
+#include "TextureArraySet.h"
+
+
+TextureArraySet::TextureArraySet() : maxSize(1024)
+{
+}
+
+void TextureArraySet::reset(int size)
+{
+	maxSize = size > 0 ? size : 1;
+	for (TextureArray& array : arrays) {
+		array.reset(0, 0);
+	}
+}
+
+TextureArraySet::Layer TextureArraySet::addLayer(const unsigned char* pixels, int width, int height, int channels)
+{
+	// 按2的倍数缩小到不超过上限，宽高比不变
+	int layerWidth = width;
+	int layerHeight = height;
+	while (layerWidth > maxSize || layerHeight > maxSize) {
+		layerWidth = layerWidth > 1 ? layerWidth / 2 : 1;
+		layerHeight = layerHeight > 1 ? layerHeight / 2 : 1;
+	}
+
+	int found = -1;
+	int empty = -1;
+	for (size_t i = 0; i < arrays.size(); i++) {
+		const TextureArray& array = arrays[i];
+		if (array.getLayerCount() > 0 && array.getWidth() == layerWidth && array.getHeight() == layerHeight) {
+			found = static_cast<int>(i);
+			break;
+		}
+		if (array.getLayerCount() == 0 && empty < 0) {
+			empty = static_cast<int>(i);
+		}
+	}
+	if (found < 0 && empty >= 0) {
+		// 复用上一次留下的纹理对象
+		found = empty;
+		arrays[found].reset(layerWidth, layerHeight);
+	}
+	if (found < 0) {
+		found = static_cast<int>(arrays.size());
+		arrays.push_back(TextureArray(layerWidth, layerHeight));
+	}
+
+	Layer result;
+	result.array = found;
+	result.layer = arrays[found].addLayer(pixels, width, height, channels);
+	return result;
+}
+
+void TextureArraySet::upload()
+{
+	for (TextureArray& array : arrays) {
+		if (array.getLayerCount() > 0) {
+			array.upload();
+		}
+		else {
+			array.clear();
+		}
+	}
+}
+
+GLuint TextureArraySet::getTexture(const Layer& layer) const
+{
+	if (layer.array < 0 || layer.array >= static_cast<int>(arrays.size())) {
+		return 0;
+	}
+	return arrays[layer.array].getTexture();
+}
+
+int TextureArraySet::getArrayCount() const
+{
+	int count = 0;
+	for (const TextureArray& array : arrays) {
+		if (array.getLayerCount() > 0) {
+			count++;
+		}
+	}
+	return count;
+}
+
+int TextureArraySet::getLayerCount() const
+{
+	int count = 0;
+	for (const TextureArray& array : arrays) {
+		count += array.getLayerCount();
+	}
+	return count;
+}
+
+size_t TextureArraySet::getTextureBytes() const
+{
+	size_t bytes = 0;
+	for (const TextureArray& array : arrays) {
+		bytes += array.getTextureBytes();
+	}
+	return bytes;
+}
+
+void TextureArraySet::clear()
+{
+	for (TextureArray& array : arrays) {
+		array.clear();
+	}
+	arrays.clear();
+}
@@ -0,0 +1,152 @@
+#include "TransientTexturePool.h"
+
+#include <iostream>
+
+
+static bool isDepthFormat(GLenum internalFormat)
+{
+	return internalFormat == GL_DEPTH24_STENCIL8;
+}
+
+static GLuint createTexture(const TransientTextureDesc& desc)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (isDepthFormat(desc.internalFormat)) {
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0,
+			GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	}
+	else {
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+	// 着色器中用 texelFetch 逐个取样，不需要过滤和mipmap
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+
+TransientTexturePool::TransientTexturePool()
+{
+}
+
+GLuint TransientTexturePool::acquire(const TransientTextureDesc& desc, bool& created)
+{
+	for (Entry& entry : textures) {
+		if (!entry.inUse && entry.desc == desc) {
+			entry.inUse = true;
+			entry.usedThisFrame = true;
+			return entry.texture;
+		}
+	}
+
+	Entry entry;
+	entry.texture = createTexture(desc);
+	entry.desc = desc;
+	entry.inUse = true;
+	entry.usedThisFrame = true;
+	entry.idleFrames = 0;
+	textures.push_back(entry);
+	created = true;
+	return entry.texture;
+}
+
+void TransientTexturePool::release(GLuint texture)
+{
+	for (Entry& entry : textures) {
+		if (entry.texture == texture) {
+			entry.inUse = false;
+			return;
+		}
+	}
+}
+
+GLuint TransientTexturePool::getFramebuffer(GLuint colorTexture, GLuint depthTexture)
+{
+	for (const FramebufferEntry& entry : framebuffers) {
+		if (entry.colorTexture == colorTexture && entry.depthTexture == depthTexture) {
+			return entry.framebuffer;
+		}
+	}
+
+	FramebufferEntry entry;
+	entry.colorTexture = colorTexture;
+	entry.depthTexture = depthTexture;
+	glGenFramebuffers(1, &entry.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, entry.framebuffer);
+	if (colorTexture != 0) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+	}
+	else {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	if (depthTexture != 0) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Framebuffer transient incomplete: 0x" << std::hex << status << std::dec << std::endl;
+	}
+	framebuffers.push_back(entry);
+	return entry.framebuffer;
+}
+
+void TransientTexturePool::deleteFramebuffers(GLuint texture)
+{
+	for (size_t i = 0; i < framebuffers.size();) {
+		if (framebuffers[i].colorTexture == texture || framebuffers[i].depthTexture == texture) {
+			glDeleteFramebuffers(1, &framebuffers[i].framebuffer);
+			framebuffers[i] = framebuffers.back();
+			framebuffers.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+void TransientTexturePool::endFrame()
+{
+	for (size_t i = 0; i < textures.size();) {
+		Entry& entry = textures[i];
+		entry.inUse = false;
+		entry.idleFrames = entry.usedThisFrame ? 0 : entry.idleFrames + 1;
+		entry.usedThisFrame = false;
+		if (entry.idleFrames > kMaxIdleFrames) {
+			deleteFramebuffers(entry.texture);
+			glDeleteTextures(1, &entry.texture);
+			textures[i] = textures.back();
+			textures.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+}
+
+size_t TransientTexturePool::getTextureBytes() const
+{
+	// RGBA8 和 D24S8 每个像素都是4字节
+	size_t bytes = 0;
+	for (const Entry& entry : textures) {
+		bytes += static_cast<size_t>(entry.desc.width) * entry.desc.height * 4;
+	}
+	return bytes;
+}
+
+void TransientTexturePool::clear()
+{
+	for (const FramebufferEntry& entry : framebuffers) {
+		glDeleteFramebuffers(1, &entry.framebuffer);
+	}
+	framebuffers.clear();
+	for (const Entry& entry : textures) {
+		glDeleteTextures(1, &entry.texture);
+	}
+	textures.clear();
+}
@@ -1,4 +1,5 @@
 ﻿#include "TriMesh.h"
+#include "MeshOptimizer.h"
 
 
 // 一些基础颜色
@@ -55,6 +56,11 @@ static glm::vec2 computePlanarUV(const glm::vec3& position, const glm::vec3& nor
 
 TriMesh::TriMesh()
 {
+	// 默认材质：与原来全局的光照参数相同
+	ambient = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	specular = glm::vec4(0.4f, 0.4f, 0.4f, 1.0f);
+	shininess = 32.0f;
 }
 
 TriMesh::~TriMesh()
@@ -102,6 +108,11 @@ std::vector<glm::vec2> TriMesh::getTexCoords()
 	return texcoords;
 }
 
+std::vector<GLuint> TriMesh::getIndices()
+{
+	return indices;
+}
+
 void TriMesh::computeTriangleNormals()
 {
 	face_normals.resize(faces.size());
@@ -204,9 +215,10 @@ void TriMesh::cleanData() {
 	colors.clear();
 	normals.clear();
 	texcoords.clear();
+	indices.clear();
 }
 
-void TriMesh::storeFacesPoints() {
+void TriMesh::storeFacesPoints(bool withTexCoords) {
 	// 计算法向量
 	if (vertex_normals.size() == 0)
 		computeVertexNormals();
@@ -229,9 +241,11 @@ void TriMesh::storeFacesPoints() {
 		colors.push_back(vertex_colors[faces[i].y]);
 		colors.push_back(vertex_colors[faces[i].z]);
 		// 纹理坐标
-		texcoords.push_back(computePlanarUV(p0, faceNormal));
-		texcoords.push_back(computePlanarUV(p1, faceNormal));
-		texcoords.push_back(computePlanarUV(p2, faceNormal));
+		if (withTexCoords) {
+			texcoords.push_back(computePlanarUV(p0, faceNormal));
+			texcoords.push_back(computePlanarUV(p1, faceNormal));
+			texcoords.push_back(computePlanarUV(p2, faceNormal));
+		}
 		// 法向量
 		if (vertex_normals.size() != 0) {
 			normals.push_back(vertex_normals[faces[i].x]);
@@ -242,6 +256,58 @@ void TriMesh::storeFacesPoints() {
 	}
 }
 
+template <typename T>
+static void remapVertices(std::vector<T>& data, const std::vector<int>& remap, size_t newCount)
+{
+	if (data.size() != remap.size()) {
+		return;
+	}
+	std::vector<T> result(newCount);
+	for (size_t i = 0; i < remap.size(); i++) {
+		if (remap[i] >= 0) {
+			result[remap[i]] = data[i];
+		}
+	}
+	data.swap(result);
+}
+
+void TriMesh::storeIndexedPoints() {
+	if (faces.size() == 0)
+		return;
+	// 加载时优化三角形顺序：顶点缓存 -> 减少重复着色 -> 顶点读取顺序
+	MeshOptimizer::optimizeVertexCache(faces, vertex_positions.size());
+	MeshOptimizer::optimizeOverdraw(faces, vertex_positions, 1.05f);
+	std::vector<int> remap = MeshOptimizer::optimizeVertexFetch(faces, vertex_positions.size());
+	size_t vertexCount = 0;
+	for (size_t i = 0; i < remap.size(); i++) {
+		if (remap[i] >= 0)
+			vertexCount++;
+	}
+	remapVertices(vertex_positions, remap, vertexCount);
+	remapVertices(vertex_colors, remap, vertexCount);
+	remapVertices(vertex_normals, remap, vertexCount);
+	// 三角形顺序变了，面法向量需要重新计算
+	face_normals.clear();
+
+	if (vertex_normals.size() == 0)
+		computeVertexNormals();
+
+	// 每个顶点只存一份，纹理坐标按顶点法向量选择投影平面
+	points = vertex_positions;
+	colors = vertex_colors;
+	normals = vertex_normals;
+	texcoords.clear();
+	for (size_t i = 0; i < vertex_positions.size(); i++) {
+		texcoords.push_back(computePlanarUV(vertex_positions[i], vertex_normals[i]));
+	}
+	indices.clear();
+	for (size_t i = 0; i < faces.size(); i++) {
+		indices.push_back(faces[i].x);
+		indices.push_back(faces[i].y);
+		indices.push_back(faces[i].z);
+	}
+}
+
 // 立方体生成12个三角形的顶点索引
 void TriMesh::generateCube(glm::vec3 _color)
 {
@@ -275,7 +341,8 @@ void TriMesh::generateCube(glm::vec3 _color)
 	faces.push_back(vec3i(1, 5, 7));
 	faces.push_back(vec3i(1, 7, 3));
 
-	storeFacesPoints();
+	// 立方体的纹理由着色器三向投影，不需要纹理坐标
+	storeFacesPoints(false);
 	
 	normals.clear();
 	// 正方形的法向量不能靠之前顶点法向量的方法直接计算，因为每个四边形平面是正交的，不是连续曲面
@@ -352,7 +419,7 @@ void TriMesh::readOff(const std::string& filename)
     }
     fin.close();
 
-    storeFacesPoints();
+    storeIndexedPoints();
 };
 
 
@@ -0,0 +1,264 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// 纹理坐标的绝对值小于该值时使用 half，精度不低于 1/512
+static const float kHalfTexCoordRange = 4.0f;
+
+static unsigned short floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned short sign = static_cast<unsigned short>((bits >> 16) & 0x8000);
+	int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+	if (exponent <= 0) {
+		// 非规格化数直接按0处理
+		return sign;
+	}
+	if (exponent >= 31) {
+		return static_cast<unsigned short>(sign | 0x7c00);
+	}
+	unsigned int half = sign | (static_cast<unsigned int>(exponent) << 10) | (mantissa >> 13);
+	// 四舍五入，进位到指数也是正确的结果
+	if (mantissa & 0x1000) {
+		half++;
+	}
+	return static_cast<unsigned short>(half);
+}
+
+static GLuint packSnorm10(float value)
+{
+	value = std::min(std::max(value, -1.0f), 1.0f);
+	int quantized = static_cast<int>(std::floor(value * 511.0f + 0.5f));
+	return static_cast<GLuint>(quantized) & 0x3ff;
+}
+
+static unsigned char packUnorm8(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return static_cast<unsigned char>(std::floor(value * 255.0f + 0.5f));
+}
+
+static unsigned short packUnorm16(float value)
+{
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return static_cast<unsigned short>(std::floor(value * 65535.0f + 0.5f));
+}
+
+template <typename T>
+static bool hasData(const std::vector<T>* data)
+{
+	return data != NULL && !data->empty();
+}
+
+
+VertexFormat::VertexFormat() : positionStride(0), stride(0), positionScale(1.0f, 1.0f, 1.0f), positionOffset(0.0f, 0.0f, 0.0f)
+{
+}
+
+void VertexFormat::append(VertexAttribFormat& attribute, GLint size, GLenum type, GLboolean normalized, GLuint bytes)
+{
+	attribute.enabled = true;
+	attribute.size = size;
+	attribute.type = type;
+	attribute.normalized = normalized;
+	// 每个属性按4字节对齐；位置单独一段，其余属性交错排列
+	GLsizei& streamStride = &attribute == &position ? positionStride : stride;
+	attribute.offset = static_cast<GLuint>(streamStride);
+	streamStride += static_cast<GLsizei>((bytes + 3) & ~3u);
+}
+
+VertexFormat VertexFormat::choose(const VertexStreams& streams, VertexPacking packing)
+{
+	VertexFormat format;
+	bool packed = packing != kVertexPackingFloat;
+
+	if (packing == kVertexPackingQuantized && hasData(streams.points)) {
+		// 按包围盒量化，反量化参数由绘制时的常量属性传入
+		glm::vec3 minimum = (*streams.points)[0];
+		glm::vec3 maximum = minimum;
+		for (const auto& point : *streams.points) {
+			minimum = glm::min(minimum, point);
+			maximum = glm::max(maximum, point);
+		}
+		format.positionOffset = minimum;
+		format.positionScale = maximum - minimum;
+		format.append(format.position, 3, GL_UNSIGNED_SHORT, GL_TRUE, 3 * sizeof(unsigned short));
+	}
+	else {
+		format.append(format.position, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3));
+	}
+
+	if (hasData(streams.colors)) {
+		bool unitRange = packed;
+		for (size_t i = 0; unitRange && i < streams.colors->size(); i++) {
+			const glm::vec3& c = (*streams.colors)[i];
+			unitRange = c.x >= 0.0f && c.x <= 1.0f && c.y >= 0.0f && c.y <= 1.0f && c.z >= 0.0f && c.z <= 1.0f;
+		}
+		if (unitRange) {
+			format.append(format.color, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4);
+		}
+		else {
+			format.append(format.color, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3));
+		}
+	}
+
+	if (hasData(streams.normals)) {
+		if (packed) {
+			format.append(format.normal, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(GLuint));
+		}
+		else {
+			format.append(format.normal, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3));
+		}
+	}
+
+	if (hasData(streams.texcoords)) {
+		bool smallRange = packed;
+		for (size_t i = 0; smallRange && i < streams.texcoords->size(); i++) {
+			const glm::vec2& t = (*streams.texcoords)[i];
+			smallRange = std::abs(t.x) < kHalfTexCoordRange && std::abs(t.y) < kHalfTexCoordRange;
+		}
+		if (smallRange) {
+			format.append(format.texcoord, 2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(unsigned short));
+		}
+		else {
+			format.append(format.texcoord, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2));
+		}
+	}
+
+	if (hasData(streams.materials)) {
+		format.append(format.material, 1, GL_INT, GL_FALSE, sizeof(GLint));
+		format.material.integer = true;
+	}
+
+	if (hasData(streams.layers)) {
+		format.append(format.layer, 1, GL_INT, GL_FALSE, sizeof(GLint));
+		format.layer.integer = true;
+	}
+	return format;
+}
+
+std::vector<unsigned char> VertexFormat::pack(const VertexStreams& streams) const
+{
+	size_t count = hasData(streams.points) ? streams.points->size() : 0;
+	size_t positionBytes = count * static_cast<size_t>(positionStride);
+	std::vector<unsigned char> data(positionBytes + count * static_cast<size_t>(stride));
+	for (size_t i = 0; i < count; i++) {
+		unsigned char* vertexPosition = &data[i * positionStride];
+		const glm::vec3& p = (*streams.points)[i];
+		if (position.type == GL_UNSIGNED_SHORT) {
+			unsigned short q[3];
+			for (int k = 0; k < 3; k++) {
+				q[k] = positionScale[k] > 0.0f ? packUnorm16((p[k] - positionOffset[k]) / positionScale[k]) : 0;
+			}
+			memcpy(vertexPosition + position.offset, q, sizeof(q));
+		}
+		else {
+			memcpy(vertexPosition + position.offset, &p[0], sizeof(glm::vec3));
+		}
+
+		if (stride == 0) {
+			continue;
+		}
+		unsigned char* vertex = &data[positionBytes + i * stride];
+
+		if (color.enabled) {
+			const glm::vec3& c = (*streams.colors)[i];
+			if (color.type == GL_UNSIGNED_BYTE) {
+				unsigned char q[4] = { packUnorm8(c.x), packUnorm8(c.y), packUnorm8(c.z), 255 };
+				memcpy(vertex + color.offset, q, sizeof(q));
+			}
+			else {
+				memcpy(vertex + color.offset, &c[0], sizeof(glm::vec3));
+			}
+		}
+
+		if (normal.enabled) {
+			const glm::vec3& n = (*streams.normals)[i];
+			if (normal.type == GL_INT_2_10_10_10_REV) {
+				GLuint q = packSnorm10(n.x) | (packSnorm10(n.y) << 10) | (packSnorm10(n.z) << 20);
+				memcpy(vertex + normal.offset, &q, sizeof(q));
+			}
+			else {
+				memcpy(vertex + normal.offset, &n[0], sizeof(glm::vec3));
+			}
+		}
+
+		if (texcoord.enabled) {
+			const glm::vec2& t = (*streams.texcoords)[i];
+			if (texcoord.type == GL_HALF_FLOAT) {
+				unsigned short q[2] = { floatToHalf(t.x), floatToHalf(t.y) };
+				memcpy(vertex + texcoord.offset, q, sizeof(q));
+			}
+			else {
+				memcpy(vertex + texcoord.offset, &t[0], sizeof(glm::vec2));
+			}
+		}
+
+		if (material.enabled) {
+			GLint m = (*streams.materials)[i];
+			memcpy(vertex + material.offset, &m, sizeof(m));
+		}
+
+		if (layer.enabled) {
+			GLint l = (*streams.layers)[i];
+			memcpy(vertex + layer.offset, &l, sizeof(l));
+		}
+	}
+	return data;
+}
+
+void VertexFormat::bindPositions() const
+{
+	glEnableVertexAttribArray(kPositionAttrib);
+	glVertexAttribPointer(kPositionAttrib, position.size, position.type, position.normalized, positionStride,
+		BUFFER_OFFSET(static_cast<size_t>(position.offset)));
+}
+
+void VertexFormat::bind(GLsizei vertexCount) const
+{
+	bindPositions();
+
+	size_t baseOffset = static_cast<size_t>(vertexCount) * positionStride;
+	const VertexAttribFormat* attributes[] = { &color, &normal, &texcoord, &material, &layer };
+	const GLuint locations[] = { kColorAttrib, kNormalAttrib, kTexCoordAttrib, kMaterialAttrib, kTextureLayerAttrib };
+	for (int i = 0; i < 5; i++) {
+		const VertexAttribFormat& attribute = *attributes[i];
+		if (!attribute.enabled) {
+			continue;
+		}
+		glEnableVertexAttribArray(locations[i]);
+		if (attribute.integer) {
+			glVertexAttribIPointer(locations[i], attribute.size, attribute.type, stride,
+				BUFFER_OFFSET(baseOffset + attribute.offset));
+		}
+		else {
+			glVertexAttribPointer(locations[i], attribute.size, attribute.type, attribute.normalized, stride,
+				BUFFER_OFFSET(baseOffset + attribute.offset));
+		}
+	}
+}
+
+bool VertexFormat::has(VertexAttribLocation location) const
+{
+	switch (location) {
+	case kPositionAttrib:
+		return position.enabled;
+	case kColorAttrib:
+		return color.enabled;
+	case kNormalAttrib:
+		return normal.enabled;
+	case kTexCoordAttrib:
+		return texcoord.enabled;
+	case kMaterialAttrib:
+		return material.enabled;
+	case kTextureLayerAttrib:
+		return layer.enabled;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,55 @@
+#include "ViewUniformBuffer.h"
+
+
+ViewUniformBuffer::ViewUniformBuffer()
+	: binding(0), buffer(0), blockSize(0), stride(0), maxViews(0), boundView(-1)
+{
+}
+
+void ViewUniformBuffer::create(GLuint newBinding, GLsizeiptr newBlockSize, int newMaxViews)
+{
+	clear();
+	binding = newBinding;
+	blockSize = newBlockSize;
+	maxViews = newMaxViews < 1 ? 1 : newMaxViews;
+
+	// 每个区间的起点必须是对齐值的整数倍
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment < 1) {
+		alignment = 1;
+	}
+	stride = (blockSize + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, stride * maxViews, NULL, GL_DYNAMIC_DRAW);
+	bind(0);
+}
+
+void ViewUniformBuffer::update(int view, const void* data)
+{
+	if (buffer == 0 || view < 0 || view >= maxViews) {
+		return;
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, stride * view, blockSize, data);
+}
+
+void ViewUniformBuffer::bind(int view)
+{
+	if (buffer == 0 || view < 0 || view >= maxViews || view == boundView) {
+		return;
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, stride * view, blockSize);
+	boundView = view;
+}
+
+void ViewUniformBuffer::clear()
+{
+	if (buffer != 0) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+	boundView = -1;
+}
@@ -0,0 +1,94 @@
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool()
+	: tasks(NULL), nextTask(0), remaining(0), generation(0), stopping(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+void WorkerPool::start(int threadCount)
+{
+	stop();
+	if (threadCount < 0) {
+		int cores = static_cast<int>(std::thread::hardware_concurrency());
+		threadCount = cores > 1 ? cores - 1 : 0;
+	}
+	stopping = false;
+	for (int i = 0; i < threadCount; i++) {
+		threads.push_back(std::thread(&WorkerPool::workerLoop, this));
+	}
+}
+
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+bool WorkerPool::runNextTask(std::unique_lock<std::mutex>& lock)
+{
+	if (tasks == NULL || nextTask >= tasks->size()) {
+		return false;
+	}
+	const Task& task = (*tasks)[nextTask++];
+	lock.unlock();
+	task();
+	lock.lock();
+	if (--remaining == 0) {
+		done.notify_all();
+	}
+	return true;
+}
+
+void WorkerPool::run(const std::vector<Task>& taskList)
+{
+	if (taskList.empty()) {
+		return;
+	}
+	if (threads.empty()) {
+		for (const Task& task : taskList) {
+			task();
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	tasks = &taskList;
+	nextTask = 0;
+	remaining = taskList.size();
+	generation++;
+	wake.notify_all();
+
+	// 调用线程也取任务执行，剩下的等工作线程完成
+	while (runNextTask(lock)) {
+	}
+	done.wait(lock, [this]() { return remaining == 0; });
+	tasks = NULL;
+}
+
+void WorkerPool::workerLoop()
+{
+	unsigned int seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+		if (stopping) {
+			return;
+		}
+		seenGeneration = generation;
+		while (runNextTask(lock)) {
+		}
+	}
+}
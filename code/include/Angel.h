@@ -55,6 +55,14 @@ namespace Angel {
 GLuint InitShader( const char* vertexShaderFile,
 		   const char* fragmentShaderFile );
 
+//  Helper function to build a program from in-memory shader sources;
+//    program may be an already created (empty) program object, 0 creates one
+GLuint InitShaderFromSource( const char* vertexShaderSource,
+			     const char* fragmentShaderSource,
+			     const char* vertexShaderName,
+			     const char* fragmentShaderName,
+			     GLuint program = 0 );
+
 //  Defined constant for when numbers are too small to be used in the
 //    denominator of a division operation.  This is only used if the
 //    DEBUG macro is defined.
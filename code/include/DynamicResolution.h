@@ -0,0 +1,83 @@
+#ifndef _DYNAMIC_RESOLUTION_H_
+#define _DYNAMIC_RESOLUTION_H_
+
+#include "Angel.h"
+
+
+// 动态分辨率：三维场景画到离屏帧缓冲中，渲染比例根据 GL_TIME_ELAPSED 测得的GPU帧时间在上下限之间调整，
+// 场景画完后放大到窗口，之后 HUD 和玩家编号以原生分辨率画在默认帧缓冲上。
+// 离屏缓冲按最大比例分配一次，比例变化时只改变视口，不重新分配
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const { return enabled; }
+
+	// 渲染比例的上下限（按边长），以及GPU帧时间的目标值（毫秒）
+	void setScaleRange(float minScale, float maxScale);
+	void setTargetFrameTime(float milliseconds);
+	float getMinScale() const { return minScale; }
+	float getMaxScale() const { return maxScale; }
+	float getTargetFrameTime() const { return targetMs; }
+
+	// 窗口帧缓冲的尺寸
+	void resize(int width, int height);
+
+	// 读取已经完成的计时查询并调整比例，绑定场景帧缓冲和视口，开始本帧的计时
+	void beginFrame();
+	// 场景放大到窗口（颜色线性过滤，深度取最近点），之后绑定默认帧缓冲；未开启时什么也不做
+	void resolveScene();
+	// 结束本帧的计时
+	void endFrame();
+
+	// 场景所在的帧缓冲和尺寸，未开启时为默认帧缓冲和窗口尺寸
+	GLuint getSceneFramebuffer() const { return sceneActive ? framebuffer : 0; }
+	int getSceneWidth() const { return sceneWidth; }
+	int getSceneHeight() const { return sceneHeight; }
+	bool isSceneOffscreen() const { return sceneActive; }
+
+	float getScale() const { return scale; }
+	// 平滑后的GPU帧时间（毫秒），还没有结果时为0
+	float getGpuFrameTime() const { return gpuMs; }
+
+	// 释放帧缓冲、纹理和查询对象，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	// 查询结果要晚几帧才能取到，轮流使用几个查询对象，不等待GPU
+	static const int kQueryCount = 4;
+
+	void create();
+	void readQueries();
+	void updateScale(float frameMs);
+
+	bool enabled;
+	bool dirty;
+	bool sceneActive;
+	int width;
+	int height;
+	int sceneWidth;
+	int sceneHeight;
+
+	float minScale;
+	float maxScale;
+	float targetMs;
+	float scale;
+	float gpuMs;
+	int framesSinceChange;
+
+	GLuint framebuffer;
+	GLuint colorBuffer;		// 只用于 blit，使用渲染缓冲，不占用纹理单元
+	GLuint depthBuffer;
+	int bufferWidth;
+	int bufferHeight;
+
+	GLuint queries[kQueryCount];
+	bool queryPending[kQueryCount];
+	int queryIndex;
+	bool queryActive;
+};
+
+#endif
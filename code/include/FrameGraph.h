@@ -0,0 +1,91 @@
+#ifndef _FRAME_GRAPH_H_
+#define _FRAME_GRAPH_H_
+
+#include "Angel.h"
+#include "TransientTexturePool.h"
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// 帧图中资源的句柄
+typedef int FrameResource;
+const FrameResource kInvalidFrameResource = -1;
+
+// 轻量的帧图：每帧重新声明各个通道读写哪些资源，编译时剔除结果没有被用到的通道，
+// 按剩余通道的先后计算临时纹理的生命周期，从缓存池中分配，生命周期不重叠的资源共用同一张纹理。
+// 通道按声明顺序执行，声明时需要保证读取的资源已经由之前的通道写入
+class FrameGraph
+{
+public:
+	typedef std::function<void()> ExecuteFunction;
+
+	FrameGraph();
+
+	// 清空上一帧声明的通道和资源，临时纹理留在缓存池中
+	void reset();
+
+	// 由帧图分配的临时纹理
+	FrameResource createTexture(const std::string& name, const TransientTextureDesc& desc);
+	// 外部持有的帧缓冲（默认帧缓冲、动态分辨率的场景缓冲等），帧图只记录读写关系
+	FrameResource importFramebuffer(const std::string& name, GLuint framebuffer);
+	// 帧结束时需要保留结果的资源，写入它的通道不会被剔除
+	void markOutput(FrameResource resource);
+
+	int addPass(const std::string& name, ExecuteFunction execute);
+	void read(int pass, FrameResource resource);
+	void write(int pass, FrameResource resource);
+
+	// 剔除通道并分配临时纹理；返回 true 表示新建了纹理，当前纹理单元的绑定已经改变
+	bool compile();
+	// 依次执行没有被剔除的通道
+	void execute();
+
+	// 执行时取得资源对应的纹理，或以 color、depth 为附件的帧缓冲（导入的资源直接返回其帧缓冲）
+	GLuint getTexture(FrameResource resource) const;
+	GLuint getFramebuffer(FrameResource color, FrameResource depth = kInvalidFrameResource);
+
+	int getPassCount() const { return static_cast<int>(passes.size()); }
+	int getCulledPassCount() const;
+	int getTransientCount() const;
+	const TransientTexturePool& getPool() const { return pool; }
+	void print(std::ostream& out) const;
+
+	// 释放缓存池中的纹理和帧缓冲，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	struct Resource
+	{
+		std::string name;
+		bool imported;
+		GLuint framebuffer;			// 导入的资源
+		TransientTextureDesc desc;	// 临时纹理
+		GLuint texture;
+		bool output;
+		int refCount;
+		int firstPass;
+		int lastPass;
+		std::vector<int> writers;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<FrameResource> reads;
+		std::vector<FrameResource> writes;
+		int refCount;
+		bool culled;
+	};
+
+	void cullPasses();
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	TransientTexturePool pool;
+};
+
+#endif
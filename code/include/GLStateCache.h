@@ -0,0 +1,85 @@
+#ifndef _GL_STATE_CACHE_H_
+#define _GL_STATE_CACHE_H_
+
+#include "Angel.h"
+
+
+// GL状态的CPU端影子：记录当前的混合、深度、多边形偏移、程序、VAO和纹理绑定，
+// 与当前值相同的设置直接跳过，也不再需要用 glIsEnabled/glGet* 查询状态
+class GLStateCache
+{
+public:
+	static const int kMaxTextureUnits = 8;
+
+	struct Stats
+	{
+		unsigned int issued = 0;	// 实际发出的GL调用
+		unsigned int skipped = 0;	// 因状态未变化而跳过的调用
+	};
+
+	GLStateCache();
+
+	// 假定上下文处于GL默认状态（新建上下文之后调用）
+	void reset();
+	// 状态未知（例如外部代码直接修改了GL状态），之后的每个设置都会真正发出
+	void invalidate();
+	void invalidateProgram();
+	void invalidateVertexArray();
+
+	void setBlend(bool enabled);
+	void setBlendFunc(GLenum src, GLenum dst);
+	// 颜色和透明度分别设置混合因子，例如累积预乘颜色时透明度按覆盖率叠加
+	void setBlendFuncSeparate(GLenum srcColor, GLenum dstColor, GLenum srcAlpha, GLenum dstAlpha);
+	void setDepthTest(bool enabled);
+	void setDepthMask(bool enabled);
+	// 四个通道同时开关，深度预渲染时关闭颜色写入
+	void setColorMask(bool enabled);
+	void setDepthFunc(GLenum func);
+	void setCullFace(bool enabled);
+	void setPolygonOffset(bool enabled, float factor = 0.0f, float units = 0.0f);
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	bool isBlendEnabled() const { return blend == kOn; }
+	bool isDepthTestEnabled() const { return depthTest == kOn; }
+	bool getDepthMask() const { return depthMask == kOn; }
+	bool getColorMask() const { return colorMask == kOn; }
+	bool isCullFaceEnabled() const { return cullFace == kOn; }
+	GLuint getProgram() const { return program; }
+
+	const Stats& getStats() const { return stats; }
+	void resetStats();
+
+private:
+	// 开关状态有三种取值，kUnknown 表示必须重新设置
+	enum Toggle { kOff = 0, kOn = 1, kUnknown = 2 };
+
+	static int targetSlot(GLenum target);
+	bool setToggle(int& current, bool enabled);
+	void setCapability(int& current, GLenum capability, bool enabled);
+
+	int blend;
+	GLenum blendSrc;
+	GLenum blendDst;
+	GLenum blendSrcAlpha;
+	GLenum blendDstAlpha;
+	int depthTest;
+	int depthMask;
+	int colorMask;
+	GLenum depthFunc;
+	int cullFace;
+	int polygonOffset;
+	float offsetFactor;
+	float offsetUnits;
+
+	GLuint program;
+	GLuint vao;
+	GLuint activeUnit;
+	GLuint textures[kMaxTextureUnits][3];	// 2D、2D数组、立方体贴图
+
+	Stats stats;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _GEOMETRY_REGISTRY_H_
+#define _GEOMETRY_REGISTRY_H_
+
+#include "Angel.h"
+#include "TriMesh.h"
+#include "VertexFormat.h"
+
+#include <map>
+#include <string>
+
+
+// GPU上的一份几何数据，可以被多个物体引用
+struct GeometryHandle
+{
+	GLuint vao = 0;
+	GLuint positionVao = 0;	// 只有位置属性，用于深度预渲染
+	GLuint vbo = 0;
+	GLuint ebo = 0;			// 索引缓存，为0时按顶点顺序绘制
+	GLint first = 0;		// 有索引时为第一个下标的位置
+	GLsizei count = 0;		// 有索引时为下标个数
+	GLsizei vertexCount = 0;	// 缓存中的顶点数
+	// 没有逐顶点颜色时，颜色作为每次绘制的常量属性传入
+	bool hasVertexColor = false;
+	// 交错顶点格式，量化位置的反量化参数也在其中
+	VertexFormat format;
+	int refCount = 0;
+};
+
+// 几何数据注册表：顶点内容相同的网格只上传一次
+class GeometryRegistry
+{
+public:
+	GeometryRegistry();
+	~GeometryRegistry();
+
+	// 注册网格；若网格所有顶点颜色相同，则通过 constantColor 返回该颜色，
+	// 这份颜色不进入顶点缓存，因此只有颜色不同的网格可以共享几何数据
+	GeometryHandle* registerMesh(TriMesh* mesh, glm::vec3& constantColor);
+
+	// 之后注册的网格使用的顶点压缩程度
+	void setVertexPacking(VertexPacking packing) { vertexPacking = packing; }
+	VertexPacking getVertexPacking() const { return vertexPacking; }
+
+	// 把几何数据的顶点属性设置到当前绑定的顶点数组对象上，
+	// 供需要额外属性（例如实例化属性）的顶点数组对象复用同一份顶点缓存
+	static void bindAttributes(const GeometryHandle* handle);
+	// 只设置位置属性（和索引缓存）
+	static void bindPositionAttributes(const GeometryHandle* handle);
+
+	// 释放所有缓存，需要在GL上下文仍然有效时调用
+	void clear();
+
+	int getUniqueCount() const;
+	int getReferenceCount() const;
+	size_t getBufferBytes() const;
+
+private:
+	GeometryHandle* upload(const std::vector<glm::vec3>& points, const std::vector<glm::vec3>& colors,
+		const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& texcoords,
+		const std::vector<GLuint>& indices);
+
+	std::map<std::string, GeometryHandle*> entries;
+	size_t bufferBytes;
+	VertexPacking vertexPacking;
+};
+
+#endif
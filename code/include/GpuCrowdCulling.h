@@ -0,0 +1,84 @@
+#ifndef _GPU_CROWD_CULLING_H_
+#define _GPU_CROWD_CULLING_H_
+
+#include "Angel.h"
+#include "ShaderCache.h"
+#include "SpectatorCrowd.h"
+
+#include <string>
+#include <vector>
+
+
+// 观众的GPU剔除：计算着色器逐个测试观众的包围球，把在视锥体内的实例压缩到可见实例缓存，
+// 可见数量直接写入每个身体部位的间接绘制命令，CPU不需要读回结果，观众数量增加时CPU开销不变。
+// 计算着色器和间接绘制属于 GL 4.3（ARB_compute_shader 等），3.3 的 glad 中没有，
+// 运行时通过 glfwGetProcAddress 加载，不支持时仍按原来的实例化绘制画出全部观众
+class GpuCrowdCulling
+{
+public:
+	GpuCrowdCulling();
+
+	// 需要在GL上下文创建、观众部位添加之后调用；程序由 shaderCache 编译并持有，不支持时返回 false
+	bool init(ShaderCache& shaderCache, const std::string& computeShaderFile, const SpectatorCrowd& crowd);
+	bool isSupported() const { return supported; }
+
+	// 观众局部坐标（缩放前）中的包围球：球心在 (0, centerY, 0)
+	void setBounds(float centerY, float radius);
+
+	// 剔除本帧的观众：model 为人群整体的变换，viewProjections 为各视图的投影矩阵；
+	// castShadows 时阴影落在 shadowPlaneY 平面内的观众也保留
+	void cull(const SpectatorCrowd& crowd, const glm::mat4& model, const glm::mat4* viewProjections, int viewCount,
+		bool castShadows, const glm::vec3& lightPosition, float shadowPlaneY);
+
+	// 实例属性指向可见实例缓存的顶点数组对象
+	GLuint getPartVertexArray(int index) const { return parts[index].vao; }
+	// 按第 index 个部位的间接绘制命令绘制，需要先绑定 getPartVertexArray 返回的顶点数组对象
+	void drawPart(int index) const;
+
+	// 读回上一次剔除后的可见数量，会等待GPU完成，只用于统计输出
+	GLuint readVisibleCount() const;
+
+	// 释放缓存和顶点数组对象，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	typedef void (APIENTRYP DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+	typedef void (APIENTRYP DrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect);
+	typedef void (APIENTRYP DrawArraysIndirectProc)(GLenum mode, const void* indirect);
+
+	struct Part
+	{
+		GLuint vao;
+		bool indexed;
+	};
+
+	bool loadFunctions();
+	void reserve(GLsizei count);
+
+	DispatchComputeProc dispatchCompute;
+	MemoryBarrierProc memoryBarrier;
+	DrawElementsIndirectProc drawElementsIndirect;
+	DrawArraysIndirectProc drawArraysIndirect;
+	bool supported;
+
+	const ShaderProgram* cullProgram;
+	const ShaderProgram* finalizeProgram;
+	GLint modelLocation;
+	GLint planesLocation;
+	GLint viewCountLocation;
+	GLint boundsLocation;
+	GLint shadowLightLocation;
+	GLint castShadowsLocation;
+	GLint instanceCountLocation;
+	GLint partCountLocation;
+
+	GLuint visibleBuffer;
+	GLuint commandBuffer;
+	GLsizei capacity;
+	std::vector<Part> parts;
+	float boundCenterY;
+	float boundRadius;
+};
+
+#endif
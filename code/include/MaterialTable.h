@@ -0,0 +1,46 @@
+#ifndef _MATERIAL_TABLE_H_
+#define _MATERIAL_TABLE_H_
+
+#include "Angel.h"
+#include "TriMesh.h"
+
+#include <vector>
+
+
+// 材质表容量，需要与 fshader.glsl 中的 MAX_MATERIALS 保持一致
+const int kMaxMaterials = 64;
+
+// 一个材质（std140，与 fshader.glsl 中的 Material 对应）
+struct MaterialData
+{
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;		// w: 高光系数
+};
+
+// 材质表：所有材质放在一个 uniform buffer 中，初始化时上传一次，
+// 绘制时只需要给出材质下标（常量顶点属性、静态合批的逐顶点属性）
+class MaterialTable
+{
+public:
+	MaterialTable();
+
+	// 加入材质，相同的材质只保存一份，返回材质下标；表满时返回0（默认材质）
+	int add(const glm::vec4& ambient, const glm::vec4& diffuse, const glm::vec4& specular, float shininess);
+	// 使用网格上通过 setAmbient/setDiffuse/setSpecular/setShininess 设置的材质
+	int addFromMesh(TriMesh* mesh);
+
+	// 创建或更新 uniform buffer，并绑定到 binding
+	void upload(GLuint binding);
+
+	int getCount() const { return static_cast<int>(materials.size()); }
+
+	// 释放缓存，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	std::vector<MaterialData> materials;
+	GLuint buffer;
+};
+
+#endif
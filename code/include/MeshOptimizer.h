@@ -0,0 +1,32 @@
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include "Angel.h"
+#include "TriMesh.h"
+
+#include <vector>
+
+
+// 顶点缓存模拟使用的大小；较新的显卡缓存更大，按较小的值优化对它们同样有效
+const int kVertexCacheSize = 32;
+
+// 加载时对索引三角形重新排序：先提高顶点缓存命中率，再在保持命中率的前提下减少重复着色（overdraw），
+// 最后按第一次使用的顺序重排顶点，使顶点读取更连续
+class MeshOptimizer
+{
+public:
+	// Forsyth 的线性时间顶点缓存优化，直接修改 faces
+	static void optimizeVertexCache(std::vector<vec3i>& faces, size_t vertexCount);
+
+	// 按缓存失效的位置把三角形分成若干簇，簇内顺序不变，朝外的簇先画。
+	// threshold 允许平均缓存失效率上升的比例，例如 1.05
+	static void optimizeOverdraw(std::vector<vec3i>& faces, const std::vector<glm::vec3>& positions, float threshold);
+
+	// 按第一次被引用的顺序给顶点重新编号，remap[旧下标] = 新下标，未被引用的顶点为 -1
+	static std::vector<int> optimizeVertexFetch(std::vector<vec3i>& faces, size_t vertexCount);
+
+	// 平均每个三角形的缓存失效次数（ACMR），用于比较优化前后的效果
+	static float computeACMR(const std::vector<vec3i>& faces, size_t vertexCount, int cacheSize = kVertexCacheSize);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _PROGRAM_BINARY_CACHE_H_
+#define _PROGRAM_BINARY_CACHE_H_
+
+#include "Angel.h"
+
+#include <string>
+#include <stdint.h>
+
+
+// 程序二进制的磁盘缓存：以着色器源码和驱动信息的哈希为文件名，
+// 下次启动时直接用 glProgramBinary 恢复程序，跳过编译和链接。
+// glGetProgramBinary/glProgramBinary 属于 GL 4.1（ARB_get_program_binary），
+// 3.3 的 glad 中没有，运行时通过 glfwGetProcAddress 加载，不支持时缓存不起作用
+class ProgramBinaryCache
+{
+public:
+	ProgramBinaryCache();
+
+	// 需要在GL上下文创建之后调用；directory 不存在时会自动创建
+	bool init(const std::string& directory);
+	bool isEnabled() const { return enabled; }
+
+	// 从缓存恢复程序，没有缓存或驱动拒绝时返回0（拒绝的缓存文件会被删除）
+	GLuint load(const std::string& vSource, const std::string& fSource);
+	// 新建一个程序对象，在链接前设置 GL_PROGRAM_BINARY_RETRIEVABLE_HINT，
+	// 否则有的驱动在 glGetProgramBinary 时返回空的二进制；缓存不可用时只新建程序
+	GLuint createProgram() const;
+	// 保存链接好的程序
+	void store(GLuint program, const std::string& vSource, const std::string& fSource);
+
+	int getLoadCount() const { return loadCount; }
+	int getStoreCount() const { return storeCount; }
+	int getRejectCount() const { return rejectCount; }
+
+private:
+	typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length,
+		GLenum* binaryFormat, void* binary);
+	typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary,
+		GLsizei length);
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+	uint64_t hashSources(const std::string& vSource, const std::string& fSource) const;
+	std::string makePath(uint64_t hash) const;
+
+	GetProgramBinaryProc getProgramBinary;
+	ProgramBinaryProc programBinary;
+	ProgramParameteriProc programParameteri;
+	bool enabled;
+	std::string directory;
+	std::string driver;		// 厂商、渲染器和版本字符串，驱动更新后旧缓存自然失效
+	int loadCount;
+	int storeCount;
+	int rejectCount;
+};
+
+#endif
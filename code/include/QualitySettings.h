@@ -0,0 +1,55 @@
+#ifndef _QUALITY_SETTINGS_H_
+#define _QUALITY_SETTINGS_H_
+
+#include <ostream>
+#include <string>
+
+
+// 画质预设，低配的展台机器和转播用的机器使用同一个程序
+enum QualityPreset
+{
+	kQualityLow = 0,
+	kQualityMedium = 1,
+	kQualityHigh = 2,
+	kQualityPresetCount = 3
+};
+
+// 所有开销较大的功能的开关和参数；先由预设给出一组值，再由配置文件逐项覆盖
+struct QualitySettings
+{
+	QualityPreset preset = kQualityHigh;
+
+	// 场景内容
+	float crowdDensity = 1.0f;		// 看台上保留的观众比例，[0, 1]
+	bool planarShadows = true;		// 物体和观众的平面阴影
+	int textureSize = 1024;			// 纹理数组每层的边长上限
+	bool perPixelLighting = true;	// false 时在顶点着色器中计算光照
+	int swimRingSegments = 16;		// 游泳圈的分段数
+
+	// 渲染方式
+	bool depthPrepass = false;
+	bool frontToBack = false;		// 不透明物体按粗略深度从前往后
+	int transparentDivisor = 1;		// 半透明阶段的分辨率为 1/divisor
+	bool dynamicResolution = false;
+	float minRenderScale = 0.5f;
+	float maxRenderScale = 1.0f;
+	float targetFrameTime = 14.0f;	// 动态分辨率的GPU帧时间目标（毫秒）
+
+	// 空闲时（比赛未进行且一段时间没有输入）降低帧率
+	float idleFrameRate = 10.0f;	// 空闲时的帧率，0 表示只在有输入时重绘
+	float idleDelay = 2.0f;			// 最后一次输入后多少秒进入空闲
+
+	static QualitySettings fromPreset(QualityPreset preset);
+	static const char* getPresetName(QualityPreset preset);
+	static bool parsePresetName(const std::string& name, QualityPreset& preset);
+
+	// 读取 "key = value" 格式的配置文件，# 开头为注释；preset 先应用，其余项再覆盖。
+	// 文件无法打开时返回 false，settings 不变；无法识别的项输出警告后跳过
+	static bool load(const std::string& path, QualitySettings& settings);
+
+	// 超出范围的值截断到有效范围
+	void clamp();
+	void print(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _REDUCED_RESOLUTION_TARGET_H_
+#define _REDUCED_RESOLUTION_TARGET_H_
+
+#include "Angel.h"
+#include "TransientTexturePool.h"
+
+
+// 低分辨率的半透明目标：半透明物体（主要是水面）画到 1/2 或 1/4 分辨率的离屏缓冲中，
+// 颜色为预乘颜色，透明度为覆盖率；合成时按场景深度做双边上采样，和游泳者等物体的边缘保持清晰。
+// 低分辨率的深度由场景深度缩小得到，半透明物体仍然被不透明物体正确遮挡。
+// 纹理是帧图中的临时资源，这里只决定它们的尺寸和格式，并完成深度的复制和缩小。
+// 纹理按窗口尺寸分配，动态分辨率缩小场景时只使用左下角的一部分，比例变化时不重新分配
+class ReducedResolutionTarget
+{
+public:
+	ReducedResolutionTarget();
+
+	// divisor 为 1 时关闭，2 或 4 时长宽各缩小为 1/divisor
+	void setDivisor(int divisor);
+	int getDivisor() const { return divisor; }
+	bool isEnabled() const { return divisor > 1; }
+
+	// 场景的最大尺寸（窗口帧缓冲的尺寸），决定纹理的大小
+	void resize(int width, int height);
+	// 本帧场景实际使用的尺寸，不超过 resize 给出的尺寸
+	void setSceneSize(int width, int height);
+
+	// 全分辨率场景深度的副本（上采样时比较深度用）、低分辨率颜色和低分辨率深度；
+	// 深度格式与默认帧缓冲相同才能直接 blit
+	TransientTextureDesc getSceneDepthDesc() const;
+	TransientTextureDesc getColorDesc() const;
+	TransientTextureDesc getDepthDesc() const;
+
+	// 从 sceneFramebuffer 原样复制深度到 sceneDepthFramebuffer，再最近点缩小到 lowFramebuffer
+	void downsampleDepth(GLuint sceneFramebuffer, GLuint sceneDepthFramebuffer, GLuint lowFramebuffer) const;
+
+	// 本帧低分辨率目标中使用的区域
+	int getLowWidth() const { return lowSceneWidth; }
+	int getLowHeight() const { return lowSceneHeight; }
+	// 场景像素坐标换算到低分辨率像素坐标的比例
+	glm::vec2 getLowScale() const;
+
+private:
+	void updateLowSize();
+
+	int divisor;
+	int width;
+	int height;
+	int lowWidth;
+	int lowHeight;
+	int sceneWidth;
+	int sceneHeight;
+	int lowSceneWidth;
+	int lowSceneHeight;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include "Angel.h"
+#include "ShaderCache.h"
+#include "GeometryRegistry.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// 绘制阶段，排序键的最高位，决定各阶段的先后顺序
+enum RenderPass
+{
+	kPassOpaque = 0,		// 不透明物体，从前往后
+	kPassShadow = 1,		// 平面阴影，混合叠加在不透明物体上
+	kPassSky = 2,			// 天空盒，在不透明物体之后以 LEQUAL 绘制，被遮挡的像素不做着色
+	kPassTransparent = 3,	// 半透明物体（水面），从后往前
+	kPassHud = 4			// 玩家编号等 HUD，动态分辨率时在场景放大到窗口之后以原生分辨率绘制
+};
+
+// 不透明阶段的排序方式
+enum OpaqueOrder
+{
+	kOpaqueOrderState = 0,		// 程序、纹理优先，状态切换最少
+	kOpaqueOrderFrontToBack = 1	// 先按粗略深度分段从前往后，段内再按程序、纹理，减少被遮挡片元的着色
+};
+
+// 分屏时绘制包所属视图的位掩码，默认在所有视图中绘制
+const unsigned int kAllViews = 0xFFu;
+
+// 一次绘制所需的全部数据，排序后按顺序提交
+struct DrawPacket
+{
+	uint64_t key = 0;
+	RenderPass pass = kPassOpaque;
+	glm::mat4 model = glm::mat4(1.0f);
+
+	const ShaderProgram* shader = NULL;
+	const ShaderProgram* depthShader = NULL;	// 深度预渲染使用的变体，只有不透明阶段有
+	// 在工作线程上生成的绘制包，变体还没有编译过时 shader 为 NULL，由渲染线程合并时按 features 补上
+	ShaderVariants* variants = NULL;
+	unsigned int features = 0;
+	const GeometryHandle* geometry = NULL;
+
+	glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
+	glm::vec3 colorTint = glm::vec3(1.0f, 1.0f, 1.0f);
+	float alpha = 1.0f;
+	float shadowAlpha = 0.45f;
+	int useLighting = 1;
+	int materialIndex = 0;
+
+	GLuint textureID = 0;		// 纹理数组
+	int textureLayer = 0;
+	int useTexture = 0;
+	int useTriplanar = 0;		// 按世界坐标三向投影，texScale 为每个世界单位重复的次数
+	glm::vec2 texScale = glm::vec2(1.0f, 1.0f);
+	glm::vec2 texOffset = glm::vec2(0.0f, 0.0f);
+
+	// 实例化绘制：instanceCount > 0 时使用 instanceVao，crowdPart 为观众身体部位的下标
+	GLuint instanceVao = 0;
+	GLsizei instanceCount = 0;
+	int crowdPart = -1;
+	// GPU剔除后的观众：实际实例数由计算着色器写入间接绘制命令，instanceCount 只是上限
+	bool indirect = false;
+
+	// 只有与相机朝向有关的绘制（如面向相机的玩家编号）需要按视图分别生成
+	unsigned int viewMask = kAllViews;
+};
+
+// 每帧的绘制队列：收集绘制包，按64位排序键做基数排序
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void clear();
+	DrawPacket& push(const DrawPacket& packet);
+	// 把另一个队列（工作线程记录的绘制列表）的绘制包追加到末尾
+	void append(const RenderQueue& other);
+
+	// 排序键：阶段(4) | 程序(10) | 纹理(10) | 深度(24)；
+	// 半透明阶段深度取反并放在程序和纹理之前，保证从后往前混合
+	static uint64_t makeKey(RenderPass pass, GLuint program, GLuint texture, float depth01);
+
+	// 排序时才按当前方式重排不透明阶段的键，makeKey 不受影响
+	void setOpaqueOrder(OpaqueOrder mode) { opaqueOrder = mode; }
+	OpaqueOrder getOpaqueOrder() const { return opaqueOrder; }
+
+	void sort();
+
+	size_t size() const { return packets.size(); }
+	const DrawPacket& operator[](size_t i) const { return packets[order[i]]; }
+	// 按加入的顺序访问，排序之前用于补全绘制包
+	DrawPacket& getPacket(size_t i) { return packets[i]; }
+
+private:
+	// 阶段(4) | 粗略深度(6) | 程序(10) | 纹理(10) | 深度(24)
+	static uint64_t makeFrontToBackKey(uint64_t key);
+
+	OpaqueOrder opaqueOrder;
+	std::vector<DrawPacket> packets;
+	std::vector<uint32_t> order;	// 排序后的下标
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> keysTemp;
+	std::vector<uint32_t> orderTemp;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _SHADER_CACHE_H_
+#define _SHADER_CACHE_H_
+
+#include "Angel.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderReflection.h"
+
+#include <map>
+#include <string>
+
+
+// 一个链接好的着色器程序，以及链接后反射得到的变量表
+struct ShaderProgram
+{
+	GLuint program = 0;
+	ShaderReflection reflection;
+
+	// 按下标上传 uniform，程序中没有该变量时直接返回；调用前需要已经使用了该程序
+	void set(UniformSlot slot, int value) const;
+	void set(UniformSlot slot, float value) const;
+	void set(UniformSlot slot, const glm::vec2& value) const;
+	void set(UniformSlot slot, const glm::vec3& value) const;
+	void set(UniformSlot slot, const glm::vec4& value) const;
+	void set(UniformSlot slot, const glm::mat4& value) const;
+
+private:
+	bool check(UniformSlot slot, GLenum type) const;
+};
+
+// 着色器特性，每一位对应一个宏定义；阴影、纹理、光照不再是逐片元判断的 uniform
+enum ShaderFeature
+{
+	kShaderShadowOnly = 1 << 0,		// SHADOW_ONLY，只输出阴影颜色
+	kShaderTexture = 1 << 1,		// USE_TEXTURE
+	kShaderLighting = 1 << 2,		// USE_LIGHTING
+	kShaderCrowdInstancing = 1 << 3,	// CROWD_INSTANCING
+	kShaderTriplanar = 1 << 4,		// TRIPLANAR，按世界坐标三向投影采样纹理，需要同时开启 kShaderTexture
+	kShaderDepthOnly = 1 << 5,		// DEPTH_ONLY，深度预渲染，只写深度
+	kShaderVertexLighting = 1 << 6	// VERTEX_LIGHTING，在顶点着色器中计算光照，需要同时开启 kShaderLighting
+};
+const int kShaderVariantCount = 1 << 7;
+
+class ShaderCache;
+
+// 同一对着色器源码的全部变体，第一次使用某个变体时才编译链接
+class ShaderVariants
+{
+public:
+	ShaderVariants(ShaderCache* cache, const std::string& vshader, const std::string& fshader);
+
+	ShaderProgram* get(unsigned int features);
+	// 只查找已经编译过的变体，没有时返回 NULL；不调用GL，可以在工作线程上使用
+	ShaderProgram* find(unsigned int features) const;
+
+	// 宏定义文本，例如 "#define USE_TEXTURE\n#define USE_LIGHTING"
+	static std::string getDefines(unsigned int features);
+	// 只输出阴影或深度时纹理和光照没有意义，没有纹理时三向投影、没有光照时逐顶点光照没有意义，去掉这些位以免生成重复的变体
+	static unsigned int normalize(unsigned int features);
+
+private:
+	ShaderCache* cache;
+	std::string vshader;
+	std::string fshader;
+	ShaderProgram* variants[kShaderVariantCount];
+};
+
+// 着色器程序缓存：以着色器源码和宏定义为键，相同组合只编译链接一次
+class ShaderCache
+{
+public:
+	ShaderCache();
+	~ShaderCache();
+
+	// defines 为若干行 "#define XXX"，会插入到 #version 之后
+	ShaderProgram* getProgram(const std::string& vshader, const std::string& fshader,
+		const std::string& defines = "");
+	// 计算着色器程序（需要 GL 4.3，调用者先确认支持）；读取文件、编译或链接失败时输出日志并返回 NULL，调用者可以回退到其他路径
+	ShaderProgram* getComputeProgram(const std::string& cshader, const std::string& defines = "");
+	// 同一对源码的变体集合，由缓存持有
+	ShaderVariants* getVariants(const std::string& vshader, const std::string& fshader);
+
+	// 设置 uniform block 的绑定点和采样器的纹理单元，对之后链接的所有程序生效
+	void bindUniformBlock(const std::string& blockName, GLuint binding);
+	void bindSampler(const std::string& samplerName, GLint unit);
+
+	// 设置后新程序先尝试从磁盘的二进制缓存恢复，编译链接的程序会写入缓存
+	void setBinaryCache(ProgramBinaryCache* cache);
+
+	// 释放所有程序对象，需要在GL上下文仍然有效时调用
+	void clear();
+
+	int getProgramCount() const;
+	int getHitCount() const;
+
+private:
+	// required 为 false 时读取失败返回空字符串，否则退出程序
+	const std::string& readSource(const std::string& filename, bool required = true);
+	void applyBindings(GLuint program);
+
+	std::map<std::string, std::string> sources;		// 文件名 -> 源码
+	std::map<std::string, ShaderProgram*> programs;	// 源码+宏定义 -> 程序
+	std::map<std::string, ShaderVariants*> variantSets;	// 文件名 -> 变体集合
+	std::map<std::string, GLuint> blockBindings;	// uniform block -> 绑定点
+	std::map<std::string, GLint> samplerUnits;		// 采样器 -> 纹理单元
+	ProgramBinaryCache* binaryCache;
+	int hitCount;
+};
+
+#endif
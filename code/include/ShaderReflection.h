@@ -0,0 +1,74 @@
+#ifndef _SHADER_REFLECTION_H_
+#define _SHADER_REFLECTION_H_
+
+#include "Angel.h"
+
+#include <string>
+#include <vector>
+
+
+// 程序中用到的 uniform，按下标访问；名字见 ShaderReflection.cpp 中的 kUniformNames。
+// 新增 uniform 时在这里加一项并在名字表中加上对应的名字
+enum UniformSlot
+{
+	kUniformModel,
+	kUniformShadowAlpha,
+	kUniformColorTint,
+	kUniformAlpha,
+	kUniformTexScale,
+	kUniformTexOffset,
+
+	// 实例化观众
+	kUniformCrowdTime,
+	kUniformCrowdTarget,
+	kUniformPartPivot,
+	kUniformPartChildOffset,
+	kUniformPartSwing,
+	kUniformPartLocal,
+
+	// 低分辨率半透明的上采样
+	kUniformTransparentScale,
+	kUniformTransparentSize,
+
+	kUniformSlotCount
+};
+
+// 一个活动的 uniform 或顶点属性
+struct ShaderVariable
+{
+	std::string name;	// 数组去掉末尾的 "[0]"
+	GLint location = -1;
+	GLenum type = 0;
+	GLint size = 0;
+};
+
+// 链接后用 glGetActiveUniform/glGetActiveAttrib 枚举一次程序的变量，
+// 之后按 UniformSlot 下标取位置，绘制时不再按名字查询
+class ShaderReflection
+{
+public:
+	ShaderReflection();
+
+	void reflect(GLuint program);
+
+	GLint getLocation(UniformSlot slot) const { return slots[slot]; }
+	GLenum getType(UniformSlot slot) const { return slotTypes[slot]; }
+	bool has(UniformSlot slot) const { return slots[slot] != -1; }
+
+	// 按名字查找，只用于初始化，找不到返回 NULL
+	const ShaderVariable* findUniform(const std::string& name) const;
+	const ShaderVariable* findAttribute(const std::string& name) const;
+
+	const std::vector<ShaderVariable>& getUniforms() const { return uniforms; }
+	const std::vector<ShaderVariable>& getAttributes() const { return attributes; }
+
+	static const char* getSlotName(UniformSlot slot);
+
+private:
+	std::vector<ShaderVariable> uniforms;
+	std::vector<ShaderVariable> attributes;
+	GLint slots[kUniformSlotCount];
+	GLenum slotTypes[kUniformSlotCount];
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _SKYBOX_CUBEMAP_H_
+#define _SKYBOX_CUBEMAP_H_
+
+#include "Angel.h"
+
+#include <string>
+#include <vector>
+
+
+// 立方体贴图的六个面，顺序与 GL_TEXTURE_CUBE_MAP_POSITIVE_X + i 相同。
+// 着色器采样时翻转 z，因此 +Z 为前方（相机默认朝向），-Z 为后方
+enum CubeFace
+{
+	kCubeRight = 0,		// +X
+	kCubeLeft = 1,		// -X
+	kCubeTop = 2,		// +Y
+	kCubeBottom = 3,	// -Y
+	kCubeFront = 4,		// +Z
+	kCubeBack = 5,		// -Z
+	kCubeFaceCount = 6
+};
+
+// 一张网格图中每个面所在的格子（列、行，从左上角开始）
+struct CubemapGridLayout
+{
+	int columns;
+	int rows;
+	int cells[kCubeFaceCount][2];
+};
+
+// 横向十字：第二行为 左 前 右 后，上下两面在前面的上方和下方
+extern const CubemapGridLayout kCubemapCrossLayout;
+// 3x2 网格：第一行 右 左 上，第二行 下 前 后（.tmp_skybox_tiles 中 tile_rX_cY 的排列）
+extern const CubemapGridLayout kCubemapGrid3x2Layout;
+
+// 天空盒立方体贴图：图片在工作线程中解码和切分，完成后在调用线程上传
+class SkyboxCubemap
+{
+public:
+	SkyboxCubemap();
+
+	// 六张单独的图片，按 CubeFace 的顺序给出，每张在一个工作线程中解码
+	bool loadFaces(const std::string paths[kCubeFaceCount]);
+	// 一张按 layout 排列的网格图，解码后每个面在一个工作线程中切出
+	bool loadGrid(const std::string& path, const CubemapGridLayout& layout);
+
+	GLuint getTexture() const { return texture; }
+	int getFaceSize() const { return faceSize; }
+
+	// 释放纹理，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	struct FaceImage
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		std::vector<unsigned char> pixels;
+	};
+
+	bool upload(const FaceImage faces[kCubeFaceCount]);
+
+	GLuint texture;
+	int faceSize;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _SPECTATOR_CROWD_H_
+#define _SPECTATOR_CROWD_H_
+
+#include "Angel.h"
+#include "ShaderCache.h"
+#include "GeometryRegistry.h"
+
+#include <vector>
+
+
+// 一个观众的实例数据，与 vshader.glsl 中 CROWD_INSTANCING 的实例属性对应
+struct CrowdInstance
+{
+	glm::vec4 positionScale;	// xyz: 站立位置, w: 整体缩放
+	glm::vec4 tintPhase;		// rgb: 衣服颜色, a: 欢呼动画的相位
+};
+
+// 观众的一个身体部位：变换为 T(pivot) * Rz(swing.x * 大臂角) * T(childOffset) * Rz(swing.y * 小臂角) * local
+struct CrowdPart
+{
+	const GeometryHandle* geometry = NULL;
+	GLuint vao = 0;				// 几何属性 + 实例属性
+	glm::vec3 pivot = glm::vec3(0.0f);
+	glm::vec3 childOffset = glm::vec3(0.0f);
+	glm::vec2 swing = glm::vec2(0.0f);
+	glm::mat4 local = glm::mat4(1.0f);
+};
+
+// 实例化绘制的观众：所有观众的位置、颜色、相位放在一个实例缓存中，
+// 每个身体部位对整个人群只需要一次 glDrawArraysInstanced，
+// 朝向和挥手动画在顶点着色器中计算，每帧只更新时间和朝向目标两个 uniform
+class SpectatorCrowd
+{
+public:
+	SpectatorCrowd();
+	~SpectatorCrowd();
+
+	int addPart(const GeometryHandle* geometry, const glm::vec3& pivot, const glm::vec3& childOffset,
+		const glm::vec2& swing, const glm::mat4& local);
+
+	// 上传实例数据，只在人群布局变化时调用
+	void setInstances(const std::vector<CrowdInstance>& instances);
+
+	// 设置本帧的动画时间和观众朝向的目标位置
+	void setFrame(float time, const glm::vec3& target);
+
+	// 上传部位相关的 uniform，shader 为当前使用的 CROWD_INSTANCING 变体
+	void applyPart(const ShaderProgram* shader, int index) const;
+
+	int getPartCount() const { return static_cast<int>(parts.size()); }
+	const CrowdPart& getPart(int index) const { return parts[index]; }
+	GLsizei getInstanceCount() const { return instanceCount; }
+	GLuint getInstanceBuffer() const { return instanceBuffer; }
+
+	// 为第 index 个部位新建一个顶点数组对象，实例属性来自 buffer（布局与 CrowdInstance 相同），
+	// 用于GPU剔除后的可见实例缓存；返回的对象由调用者释放
+	GLuint createInstanceVertexArray(int index, GLuint buffer) const;
+
+	// 释放缓存和顶点数组对象，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	static GLuint createVertexArray(const CrowdPart& part, GLuint buffer);
+
+	std::vector<CrowdPart> parts;
+	GLuint instanceBuffer;
+	GLsizei instanceCount;
+	float time;
+	glm::vec3 target;
+};
+
+#endif
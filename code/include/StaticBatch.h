@@ -0,0 +1,66 @@
+#ifndef _STATIC_BATCH_H_
+#define _STATIC_BATCH_H_
+
+#include "Angel.h"
+#include "TriMesh.h"
+#include "RenderQueue.h"
+#include "VertexFormat.h"
+
+#include <vector>
+
+
+// 静态合批：把不会移动的物体在初始化时变换到世界坐标，按材质分组后放进同一个顶点缓存。
+// 每帧每个材质组只需要一个绘制包，模型矩阵为单位矩阵
+class StaticBatch
+{
+public:
+	StaticBatch();
+	~StaticBatch();
+
+	// 开始收集；之前的结果会被释放
+	void begin();
+	// 加入一次绘制，packet 提供材质和模型矩阵，顶点数据来自 mesh
+	void add(const DrawPacket& packet, TriMesh* mesh);
+	// 上传所有材质组，之后 getGroup 返回的绘制包可以直接提交
+	void end();
+
+	// end 上传时使用的顶点压缩程度
+	void setVertexPacking(VertexPacking packing) { vertexPacking = packing; }
+
+	bool isBuilt() const { return built; }
+	int getGroupCount() const { return static_cast<int>(groups.size()); }
+	const DrawPacket& getGroup(int index) const { return groups[index].packet; }
+	// 合并前的绘制次数
+	int getSourceDrawCount() const { return sourceDrawCount; }
+	size_t getBufferBytes() const { return bufferBytes; }
+
+	// 释放缓存，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	struct Group
+	{
+		DrawPacket packet;
+		GeometryHandle geometry;
+		std::vector<glm::vec3> points;
+		std::vector<glm::vec3> colors;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texcoords;
+		std::vector<GLint> materials;
+		std::vector<GLint> layers;
+	};
+
+	static bool sameMaterial(const DrawPacket& a, const DrawPacket& b);
+	Group& findGroup(const DrawPacket& packet);
+
+	std::vector<Group> groups;
+	GLuint vao;
+	GLuint positionVao;
+	GLuint vbo;
+	int sourceDrawCount;
+	size_t bufferBytes;
+	bool built;
+	VertexPacking vertexPacking;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _TEXTURE_ARRAY_H_
+#define _TEXTURE_ARRAY_H_
+
+#include "Angel.h"
+
+#include <vector>
+
+
+// 纹理数组：尺寸相同的贴图放进一个 GL_TEXTURE_2D_ARRAY（分组见 TextureArraySet），
+// 绘制时只需要给出层号（常量顶点属性、静态合批的逐顶点属性），不再逐物体切换纹理
+class TextureArray
+{
+public:
+	// 每一层的尺寸，所有层相同
+	TextureArray(GLsizei width, GLsizei height);
+
+	// 加入一张图片（1、3或4通道，8位），尺寸不同时双线性缩放到层的尺寸；返回层号
+	int addLayer(const unsigned char* pixels, int width, int height, int channels);
+
+	// 丢弃所有层并修改层的尺寸，纹理对象保留；重新加入各层并上传后，物体记录的纹理名仍然有效
+	void reset(GLsizei width, GLsizei height);
+
+	// 创建纹理并上传所有层，生成mipmap；之后CPU端的像素被释放
+	GLuint upload();
+
+	GLuint getTexture() const { return texture; }
+	GLsizei getWidth() const { return width; }
+	GLsizei getHeight() const { return height; }
+	int getLayerCount() const { return layerCount; }
+	size_t getTextureBytes() const;
+
+	// 释放纹理，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	std::vector<unsigned char> pixels;	// 依次存放每一层的 RGBA8 像素
+	GLsizei width;
+	GLsizei height;
+	int layerCount;
+	GLuint texture;
+};
+
+#endif
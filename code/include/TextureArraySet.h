@@ -0,0 +1,46 @@
+#ifndef _TEXTURE_ARRAY_SET_H_
+#define _TEXTURE_ARRAY_SET_H_
+
+#include "Angel.h"
+#include "TextureArray.h"
+
+#include <vector>
+
+
+// 按尺寸分组的纹理数组：每张贴图保持原来的宽高比，边长超过上限时按2的倍数缩小，
+// 缩小后尺寸相同的贴图放进同一个 GL_TEXTURE_2D_ARRAY；不放大小图，也不拉伸非正方形的图
+class TextureArraySet
+{
+public:
+	// 贴图在哪个纹理数组的哪一层
+	struct Layer
+	{
+		int array = -1;
+		int layer = -1;
+	};
+
+	TextureArraySet();
+
+	// 丢弃所有层并设置边长上限，纹理对象保留给下一次上传复用
+	void reset(int maxSize);
+
+	// 加入一张图片（1、3或4通道，8位），放进尺寸相同的纹理数组，没有时新建一个
+	Layer addLayer(const unsigned char* pixels, int width, int height, int channels);
+
+	// 上传所有纹理数组并生成mipmap；没有层的数组释放其纹理
+	void upload();
+
+	GLuint getTexture(const Layer& layer) const;
+	int getArrayCount() const;
+	int getLayerCount() const;
+	size_t getTextureBytes() const;
+
+	// 释放所有纹理，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	std::vector<TextureArray> arrays;
+	int maxSize;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _TRANSIENT_TEXTURE_POOL_H_
+#define _TRANSIENT_TEXTURE_POOL_H_
+
+#include "Angel.h"
+
+#include <vector>
+
+
+// 临时纹理的描述，尺寸和格式都相同的纹理可以互相替代
+struct TransientTextureDesc
+{
+	int width = 0;
+	int height = 0;
+	GLenum internalFormat = GL_RGBA8;	// GL_RGBA8 或 GL_DEPTH24_STENCIL8
+
+	bool operator==(const TransientTextureDesc& other) const
+	{
+		return width == other.width && height == other.height && internalFormat == other.internalFormat;
+	}
+};
+
+// 帧图使用的临时纹理缓存：同一帧内生命周期不重叠的资源共用一张纹理，纹理和帧缓冲跨帧保留，
+// 连续几帧没有用到（例如窗口尺寸或分辨率比例改变后）才释放
+class TransientTexturePool
+{
+public:
+	TransientTexturePool();
+
+	// 取一张符合描述的空闲纹理，没有时新建；新建时 created 置为 true，当前纹理单元的绑定已经改变
+	GLuint acquire(const TransientTextureDesc& desc, bool& created);
+	// 纹理回到空闲状态，同一帧中之后的资源可以复用
+	void release(GLuint texture);
+
+	// 以这两张纹理为附件的帧缓冲，为0表示没有该附件；帧缓冲随纹理一起缓存
+	GLuint getFramebuffer(GLuint colorTexture, GLuint depthTexture);
+
+	// 每帧结束时调用，释放连续 kMaxIdleFrames 帧没有用到的纹理
+	void endFrame();
+
+	size_t getTextureCount() const { return textures.size(); }
+	size_t getTextureBytes() const;
+
+	// 释放所有纹理和帧缓冲，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	static const int kMaxIdleFrames = 3;
+
+	struct Entry
+	{
+		GLuint texture;
+		TransientTextureDesc desc;
+		bool inUse;
+		bool usedThisFrame;
+		int idleFrames;
+	};
+
+	struct FramebufferEntry
+	{
+		GLuint colorTexture;
+		GLuint depthTexture;
+		GLuint framebuffer;
+	};
+
+	void deleteFramebuffers(GLuint texture);
+
+	std::vector<Entry> textures;
+	std::vector<FramebufferEntry> framebuffers;
+};
+
+#endif
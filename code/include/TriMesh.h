@@ -30,6 +30,8 @@ public:
 	std::vector<glm::vec3> getColors();
 	std::vector<glm::vec3> getNormals();
 	std::vector<glm::vec2> getTexCoords();
+	// 索引网格的三角形下标；为空时 points 等容器按三角形逐个展开
+	std::vector<GLuint> getIndices();
 
 	void computeTriangleNormals();
 	void computeVertexNormals();
@@ -62,8 +64,12 @@ public:
 	void readOff(const std::string& filename);
 
 	// 将读取的顶点根据三角面片上的顶点下标逐个加入
-	// 要传递给GPU的points等容器内
-	void storeFacesPoints();
+	// 要传递给GPU的points等容器内；withTexCoords 为 false 时不生成纹理坐标，
+	// 由片元着色器按世界坐标三向投影采样（程序生成的立方体）
+	void storeFacesPoints(bool withTexCoords = true);
+	// 顶点共享的网格：重排三角形和顶点顺序后，points 等容器保存每个顶点一份，
+	// 三角形通过 indices 引用顶点。需要分裂法向量的平面网格（立方体）仍使用 storeFacesPoints
+	void storeIndexedPoints();
 
 	// 清除数据
 	void cleanData();
@@ -80,6 +86,7 @@ protected:
 	std::vector<glm::vec3> colors;	// 传入着色器的颜色
 	std::vector<glm::vec3> normals;	// 传入着色器的法向量
 	std::vector<glm::vec2> texcoords;	// 传入着色器的纹理坐标
+	std::vector<GLuint> indices;	// 传入着色器的三角形下标（索引网格）
 
 	glm::vec3 translation;			// 物体的平移参数
 	glm::vec3 rotation;				// 物体的旋转参数
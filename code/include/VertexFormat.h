@@ -0,0 +1,101 @@
+#ifndef _VERTEX_FORMAT_H_
+#define _VERTEX_FORMAT_H_
+
+#include "Angel.h"
+
+#include <vector>
+
+
+// 顶点属性的固定位置，与 vshader.glsl 中的 layout(location = N) 保持一致
+enum VertexAttribLocation
+{
+	kPositionAttrib = 0,
+	kColorAttrib = 1,
+	kNormalAttrib = 2,
+	kTexCoordAttrib = 3,
+
+	// 实例化绘制的逐实例属性
+	kInstancePositionAttrib = 4,
+	kInstanceTintAttrib = 5,
+
+	// 材质表下标（整数属性）；一般作为每次绘制的常量属性传入
+	kMaterialAttrib = 6,
+
+	// 量化位置的反量化参数：position = vPosition * scale + offset，作为每次绘制的常量属性传入
+	kPositionScaleAttrib = 7,
+	kPositionOffsetAttrib = 8,
+
+	// 纹理数组的层号（整数属性）；与材质下标一样作为常量属性或静态合批的逐顶点属性
+	kTextureLayerAttrib = 9
+};
+
+// 顶点数据的压缩程度
+enum VertexPacking
+{
+	kVertexPackingFloat,		// 全部为 float，交错排列
+	kVertexPackingCompact,		// 法向量 10:10:10:2，颜色 unorm8，纹理坐标 half，位置仍为 float
+	kVertexPackingQuantized		// 在 Compact 的基础上位置量化为 unorm16，按包围盒反量化
+};
+
+// 一个顶点属性在交错缓存中的格式
+struct VertexAttribFormat
+{
+	bool enabled = false;
+	GLint size = 0;
+	GLenum type = GL_FLOAT;
+	GLboolean normalized = GL_FALSE;
+	bool integer = false;		// 用 glVertexAttribIPointer 设置
+	GLuint offset = 0;
+};
+
+// 打包前的顶点数据，各数组长度相同或为空
+struct VertexStreams
+{
+	const std::vector<glm::vec3>* points = NULL;
+	const std::vector<glm::vec3>* colors = NULL;
+	const std::vector<glm::vec3>* normals = NULL;
+	const std::vector<glm::vec2>* texcoords = NULL;
+	const std::vector<GLint>* materials = NULL;
+	const std::vector<GLint>* layers = NULL;
+};
+
+// 顶点格式：上传时由 choose 根据数据和压缩程度确定一次，之后打包顶点和设置顶点属性指针都使用同一份描述。
+// 缓存分两段：先是紧密排列的位置，供只写深度的绘制使用；后面是交错排列的其余属性
+class VertexFormat
+{
+public:
+	VertexFormat();
+
+	// 颜色超出[0, 1]或纹理坐标范围较大时，对应属性保留 float，避免压缩后失真
+	static VertexFormat choose(const VertexStreams& streams, VertexPacking packing);
+
+	// 按格式把顶点打包成 [位置][交错的其余属性] 两段
+	std::vector<unsigned char> pack(const VertexStreams& streams) const;
+
+	// 在当前绑定的 GL_ARRAY_BUFFER 上设置全部顶点属性指针，vertexCount 用于定位第二段
+	void bind(GLsizei vertexCount) const;
+	// 只设置位置属性（深度预渲染）
+	void bindPositions() const;
+
+	bool has(VertexAttribLocation location) const;
+
+	GLsizei getVertexSize() const { return positionStride + stride; }
+	const glm::vec3& getPositionScale() const { return positionScale; }
+	const glm::vec3& getPositionOffset() const { return positionOffset; }
+
+private:
+	void append(VertexAttribFormat& attribute, GLint size, GLenum type, GLboolean normalized, GLuint bytes);
+
+	VertexAttribFormat position;
+	VertexAttribFormat color;
+	VertexAttribFormat normal;
+	VertexAttribFormat texcoord;
+	VertexAttribFormat material;
+	VertexAttribFormat layer;
+	GLsizei positionStride;		// 位置段中每个顶点的字节数
+	GLsizei stride;				// 交错段中每个顶点的字节数
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+};
+
+#endif
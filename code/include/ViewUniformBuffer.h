@@ -0,0 +1,36 @@
+#ifndef _VIEW_UNIFORM_BUFFER_H_
+#define _VIEW_UNIFORM_BUFFER_H_
+
+#include "Angel.h"
+
+
+// 多个视图的每帧数据放在同一个 uniform buffer 中，每个视图占一段按 GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 对齐的区间。
+// 提交时用 glBindBufferRange 把当前视图的区间绑定到 uniform block 的绑定点，着色器不需要知道有几个视图
+class ViewUniformBuffer
+{
+public:
+	ViewUniformBuffer();
+
+	// 为 maxViews 个大小为 blockSize 的数据块分配缓冲，并把第0个视图绑定到 binding
+	void create(GLuint binding, GLsizeiptr blockSize, int maxViews);
+	// 上传一个视图的数据，data 的大小为 blockSize
+	void update(int view, const void* data);
+	// 把视图的区间绑定到绑定点，与当前绑定的视图相同时跳过
+	void bind(int view);
+
+	int getMaxViews() const { return maxViews; }
+	GLsizeiptr getStride() const { return stride; }
+
+	// 释放缓冲，需要在GL上下文仍然有效时调用
+	void clear();
+
+private:
+	GLuint binding;
+	GLuint buffer;
+	GLsizeiptr blockSize;
+	GLsizeiptr stride;
+	int maxViews;
+	int boundView;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _WORKER_POOL_H_
+#define _WORKER_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// 常驻的工作线程：每帧把一组互不依赖的任务交给它们，调用线程也参与执行，全部完成后才返回。
+// 线程在 start 时创建一次，不在每帧创建和销毁；任务中不能调用GL
+class WorkerPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	WorkerPool();
+	~WorkerPool();
+
+	// threadCount 为工作线程数（不含调用线程），小于0时按CPU核数减1
+	void start(int threadCount = -1);
+	void stop();
+	int getThreadCount() const { return static_cast<int>(threads.size()); }
+
+	// 执行 tasks 中的全部任务，返回时都已完成；没有工作线程时在调用线程上依次执行
+	void run(const std::vector<Task>& tasks);
+
+private:
+	void workerLoop();
+	// 取下一个任务执行，没有剩余任务时返回 false；调用时持有锁
+	bool runNextTask(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::vector<Task>* tasks;
+	size_t nextTask;
+	size_t remaining;
+	unsigned int generation;
+	bool stopping;
+};
+
+#endif
@@ -1,6 +1,23 @@
 #include "Angel.h"
 #include "TriMesh.h"
 #include "Camera.h"
+#include "ShaderCache.h"
+#include "GeometryRegistry.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
+#include "SpectatorCrowd.h"
+#include "StaticBatch.h"
+#include "ProgramBinaryCache.h"
+#include "MaterialTable.h"
+#include "TextureArraySet.h"
+#include "SkyboxCubemap.h"
+#include "ReducedResolutionTarget.h"
+#include "DynamicResolution.h"
+#include "QualitySettings.h"
+#include "ViewUniformBuffer.h"
+#include "FrameGraph.h"
+#include "WorkerPool.h"
+#include "GpuCrowdCulling.h"
 
 #define STBI_WINDOWS_UTF8
 #define STB_IMAGE_IMPLEMENTATION
@@ -15,61 +32,43 @@
 #include <assert.h>
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <climits>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
 #endif
 
 
 struct openGLObject
 {
-	// 顶点数组对象
-	GLuint vao;
-	// 顶点缓存对象
-	GLuint vbo;
-
-	// 着色器程序
-	GLuint program;
-	// 着色器文件
-	std::string vshader;
-	std::string fshader;
-	// 着色器变量
-	GLuint pLocation;
-	GLuint cLocation;
-	GLuint nLocation;
-	GLuint tLocation;
-
-	// 投影变换变量
-	GLuint modelLocation;
-	GLuint viewLocation;
-	GLuint projectionLocation;
-
-	// 阴影变量
-	GLuint shadowLocation;
-
-	// 纹理变量
-	GLuint useTextureLocation;
-	GLuint texScaleLocation;
-	GLuint texOffsetLocation;
-	GLuint textureLocation;
+	// 顶点数据（由几何注册表共享）
+	GeometryHandle* geometry = NULL;
+	// 网格没有逐顶点颜色时使用的颜色
+	glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
+
+	// 着色器变体集合（由着色器缓存共享），绘制时按阴影、纹理、光照选择变体
+	ShaderVariants* shaders = NULL;
+
+	// 纹理变量：textureID 为纹理数组，textureLayer 为其中的层
 	GLuint textureID = 0;
+	int textureLayer = 0;
 	int useTexture = 0;
+	// 三向投影时不使用纹理坐标，texScale 为每个世界单位重复的次数
+	int useTriplanar = 0;
 	glm::vec2 texScale = glm::vec2(1.0f, 1.0f);
 	glm::vec2 texOffset = glm::vec2(0.0f, 0.0f);
-	GLuint colorTintLocation;
 	glm::vec3 colorTint = glm::vec3(1.0f, 1.0f, 1.0f);
-	GLuint alphaLocation;
 	float alpha = 1.0f;
 
 	// 光照变量
-	GLuint useLightingLocation;
-	GLuint lightPosLocation;
-	GLuint lightColorLocation;
-	GLuint ambientStrengthLocation;
-	GLuint specStrengthLocation;
-	GLuint shininessLocation;
-	GLuint eyePositionLocation;
 	int useLighting = 1;
+	// 材质表中的下标
+	int materialIndex = 0;
 
 	// 阴影透明度
-	GLuint shadowAlphaLocation;
 	float shadowAlpha = 0.45f;
 };
 
@@ -234,7 +233,6 @@ struct PoolScene
 	float DECK_BORDER = 15.0;
 	float DECK_THICKNESS = 2;
 	float WATER_THICKNESS = 20;
-	float SKYBOX_SIZE = 1.0;
 
 	float LADDER_HEIGHT = 2.6;
 	float LADDER_WIDTH = 1.2;
@@ -252,9 +250,6 @@ PoolScene poolScene;
 const bool kEnableTextures = true;
 const glm::vec3 kLightPosition = glm::vec3(0.0f, 110.0f, 10.0f);
 const glm::vec3 kLightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-const float kAmbientStrength = 0.5f;
-const float kSpecStrength = 0.4f;
-const float kShininess = 32.0f;
 const float kCampusScale = 10.0f;
 const float kCampusWallHeight = 50.0f;
 const float kCampusWallThickness = 2.0f;
@@ -272,12 +267,23 @@ const float kPlayerStrokeBoost = 2.5f;
 const float kPlayerSpeedDecay = 6.0f;
 const float kPlayerMaxSpeed = 16.0f;
 
-GLuint gSkyboxFrontTexture = 0;
-GLuint gSkyboxBackTexture = 0;
-GLuint gSkyboxLeftTexture = 0;
-GLuint gSkyboxRightTexture = 0;
-GLuint gSkyboxTopTexture = 0;
-GLuint gSkyboxBottomTexture = 0;
+// 场景贴图按尺寸分组放进纹理数组，物体记录所在数组的纹理名和层号；加载前按画质设置的尺寸上限重设
+TextureArraySet gSceneTextures;
+// 天空盒的立方体贴图，绑定在单独的纹理单元上
+const GLint kSkyboxTextureUnit = 1;
+SkyboxCubemap gSkybox;
+// 低分辨率的半透明阶段，合成时使用的三张纹理各占一个纹理单元
+const GLint kTransparentColorUnit = 2;
+const GLint kTransparentDepthUnit = 3;
+const GLint kSceneDepthUnit = 4;
+ReducedResolutionTarget gReducedTransparency;
+// 每帧重新声明的渲染通道，临时纹理（低分辨率半透明等）由帧图分配
+FrameGraph gFrameGraph;
+ShaderProgram* gUpsampleShader = NULL;
+// 全屏三角形的顶点由 gl_VertexID 生成，核心模式下仍需要绑定一个顶点数组对象
+GLuint gFullscreenVao = 0;
+// 动态分辨率，F7 开关
+DynamicResolution gDynamicResolution;
 glm::vec3 gRobotPosition = glm::vec3(0.0f);
 float gRobotMoveSpeed = 10.0f;
 float gRobotVelocityY = 0.0f;
@@ -313,6 +319,8 @@ bool gRaceFinished = false;
 bool gPlayerFinished = false;
 int gWinnerLane = -1;
 bool gStartRequested = false;
+// 最后一次键盘、鼠标或窗口事件的时间，用于判断是否空闲
+double gLastInputTime = 0.0;
 
 
 TriMesh* Torso = new TriMesh();
@@ -372,6 +380,82 @@ openGLObject SpectatorStandObject;
 openGLObject SpectatorObject;
 
 Camera* camera = new Camera();
+// 分屏时第二个玩家的相机；camera 始终是第0个视图的相机
+Camera* gSecondCamera = new Camera();
+
+// 着色器程序缓存
+ShaderCache gShaderCache;
+// 程序二进制的磁盘缓存，放在可执行文件旁边的 shader_cache 目录
+ProgramBinaryCache gProgramBinaryCache;
+std::string gExecutablePath;
+// GL状态影子，避免重复设置和同步查询
+GLStateCache gGLState;
+GLStateCache::Stats gLastFrameStateStats;
+size_t gLastFrameDrawCount = 0;
+
+// 每帧的相机与光照数据，布局与着色器中的 FrameData（std140）一致
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 lightPosition;
+	glm::vec4 lightColor;
+	glm::vec4 eyePosition;
+};
+const GLuint kFrameUniformBinding = 0;
+// 分屏时两个视图共用一份绘制队列，每个视图的 FrameData 在同一个缓冲中占一段
+const int kMaxViews = 2;
+ViewUniformBuffer gFrameUniforms;
+bool gSplitScreen = false;
+int gViewCount = 1;
+Camera* gViewCameras[kMaxViews] = { NULL, NULL };
+// 场景遍历时新生成的绘制包所属的视图，每个记录线程各自设置
+thread_local unsigned int gPacketViewMask = kAllViews;
+
+// 材质表，初始化时上传一次
+const GLuint kMaterialUniformBinding = 1;
+MaterialTable gMaterialTable;
+
+// 几何数据注册表
+GeometryRegistry gGeometryRegistry;
+// 顶点压缩程度，注册表和静态合批使用同一种
+VertexPacking gVertexPacking = kVertexPackingQuantized;
+
+// 每帧的绘制队列，场景遍历时只生成绘制包，最后排序统一提交
+RenderQueue gRenderQueue;
+// 场景遍历按子系统分成几个互不依赖的任务，各自写入自己的绘制列表，顺序与原来单线程遍历的顺序相同
+enum RecordList
+{
+	kRecordPlayers = 0,
+	kRecordHud,
+	kRecordSwimmers,
+	kRecordVenue,
+	kRecordCrowd,
+	kRecordListCount
+};
+RenderQueue gRecordLists[kRecordListCount];
+WorkerPool gWorkerPool;
+bool gParallelRecording = true;
+// 当前线程正在写入的绘制列表，不在记录任务中时直接写入 gRenderQueue
+thread_local RenderQueue* gRecordQueue = &gRenderQueue;
+// 画质设置，启动时从配置文件读取，运行时可以切换预设或重新读取
+const char* kQualityConfigFile = "quality.cfg";
+QualitySettings gQuality;
+
+// 实例化绘制的观众，布局只在初始化时生成一次
+SpectatorCrowd gSpectatorCrowd;
+std::vector<CrowdInstance> gSpectatorLayout;
+openGLObject* gCrowdPartObjects[10];
+bool gInstancedCrowd = true;
+// GL 4.3 时观众在GPU上按视锥体剔除，用间接绘制画出剩下的；不支持时画出全部观众
+GpuCrowdCulling gCrowdCulling;
+bool gGpuCrowdCulling = true;
+
+// 静态场景合批；gStaticCapture 不为空时，绘制函数只把物体加入合批而不进入绘制队列
+StaticBatch gStaticBatch;
+StaticBatch* gStaticCapture = NULL;
+bool gUseStaticBatch = true;
 
 // 获取生成的所有模型，用于结束程序时释放内存
 std::vector<TriMesh*> meshList;
@@ -382,61 +466,461 @@ float getGroundTopY();
 float getCampusHalfExtent();
 float hash01(unsigned int seed);
 
+void bindGeometry(GLuint vao, const GeometryHandle* geometry, const glm::vec3& color, int materialIndex, int textureLayer)
+{
+	// 共享同一份几何数据的绘制不需要重新绑定顶点数组对象
+	gGLState.bindVertexArray(vao);
+	if (!geometry->hasVertexColor) {
+		glVertexAttrib3fv(kColorAttrib, &color[0]);
+	}
+	// 量化位置的反量化参数，未量化的几何数据为单位变换
+	glVertexAttrib3fv(kPositionScaleAttrib, &geometry->format.getPositionScale()[0]);
+	glVertexAttrib3fv(kPositionOffsetAttrib, &geometry->format.getPositionOffset()[0]);
+	// 静态合批的顶点数组对象带有逐顶点的材质下标和纹理层，其余使用常量属性
+	glVertexAttribI1i(kMaterialAttrib, materialIndex);
+	glVertexAttribI1i(kTextureLayerAttrib, textureLayer);
+}
+
+// 物体中心到相机的距离，归一化到[0, 1]，用作排序键中的深度；分屏时队列只排序一次，按第0个视图的相机计算
+float getViewDepth01(const glm::mat4& modelMatrix)
+{
+	glm::vec4 center = modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	if (std::abs(center.w) > 1e-6f) {
+		center /= center.w;
+	}
+	float distance = glm::length(glm::vec3(center) - glm::vec3(camera->eye));
+	return distance / camera->zFar;
+}
+
+DrawPacket makePacket(RenderPass pass, const glm::mat4& modelMatrix, const openGLObject& object,
+	unsigned int extraFeatures = 0)
+{
+	DrawPacket packet;
+	packet.pass = pass;
+	packet.model = modelMatrix;
+	packet.geometry = object.geometry;
+	packet.color = object.color;
+	packet.colorTint = object.colorTint;
+	packet.alpha = object.alpha;
+	packet.shadowAlpha = object.shadowAlpha;
+	packet.useLighting = object.useLighting;
+	packet.materialIndex = object.materialIndex;
+	packet.useTexture = (object.useTexture == 1 && object.textureID != 0) ? 1 : 0;
+	packet.textureID = packet.useTexture == 1 ? object.textureID : 0;
+	packet.textureLayer = packet.useTexture == 1 ? object.textureLayer : 0;
+	packet.useTriplanar = packet.useTexture == 1 ? object.useTriplanar : 0;
+	packet.texScale = object.texScale;
+	packet.texOffset = object.texOffset;
+	packet.viewMask = gPacketViewMask;
+
+	// 每个绘制包选择只包含所需功能的着色器变体
+	unsigned int features = extraFeatures;
+	if (pass == kPassShadow) {
+		features |= kShaderShadowOnly;
+	}
+	if (packet.useTexture == 1) {
+		features |= kShaderTexture;
+	}
+	if (packet.useTriplanar == 1) {
+		features |= kShaderTriplanar;
+	}
+	if (packet.useLighting == 1) {
+		features |= kShaderLighting;
+		if (!gQuality.perPixelLighting) {
+			features |= kShaderVertexLighting;
+		}
+	}
+	packet.variants = object.shaders;
+	packet.features = features;
+	// 工作线程上不能编译着色器，还没有编译过的变体留给渲染线程在合并时补上
+	packet.shader = object.shaders->find(features);
+	if (pass == kPassOpaque) {
+		packet.depthShader = object.shaders->find(kShaderDepthOnly | (features & kShaderCrowdInstancing));
+	}
+	if (packet.shader != NULL) {
+		packet.key = RenderQueue::makeKey(pass, packet.shader->program, packet.textureID, getViewDepth01(modelMatrix));
+	}
+	return packet;
+}
+
+// 补上记录时还没有编译过的着色器变体和依赖程序的排序键，只能在渲染线程上调用
+void resolvePacketShaders(DrawPacket& packet)
+{
+	if (packet.shader == NULL) {
+		packet.shader = packet.variants->get(packet.features);
+		packet.key = RenderQueue::makeKey(packet.pass, packet.shader->program, packet.textureID, getViewDepth01(packet.model));
+	}
+	if (packet.pass == kPassOpaque && packet.depthShader == NULL) {
+		packet.depthShader = packet.variants->get(kShaderDepthOnly | (packet.features & kShaderCrowdInstancing));
+	}
+}
+
+void queueDraw(RenderPass pass, const glm::mat4& modelMatrix, const openGLObject& object)
+{
+	gRecordQueue->push(makePacket(pass, modelMatrix, object));
+}
+
 void drawMesh(glm::mat4 modelMatrix, TriMesh* mesh, openGLObject object) {
+	// 父节点矩阵 * 本节点局部变换矩阵；半透明物体进入半透明阶段
+	RenderPass pass = object.alpha < 0.999f ? kPassTransparent : kPassOpaque;
+	if (gStaticCapture != NULL) {
+		DrawPacket packet = makePacket(pass, modelMatrix, object);
+		resolvePacketShaders(packet);
+		gStaticCapture->add(packet, mesh);
+		return;
+	}
+	queueDraw(pass, modelMatrix, object);
+}
+
+// 每个阶段的混合、深度状态只在阶段切换时设置一次
+void applyPassState(RenderPass pass)
+{
+	switch (pass) {
+	case kPassOpaque:
+		// 做过深度预渲染时深度已经写好，只在深度相等的片元上着色
+		gGLState.setDepthTest(true);
+		gGLState.setDepthFunc(gQuality.depthPrepass ? GL_EQUAL : GL_LESS);
+		gGLState.setDepthMask(!gQuality.depthPrepass);
+		gGLState.setBlend(false);
+		gGLState.setPolygonOffset(false);
+		break;
+	case kPassShadow:
+		gGLState.setDepthTest(true);
+		gGLState.setDepthFunc(GL_LESS);
+		gGLState.setDepthMask(true);
+		gGLState.setBlend(true);
+		gGLState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gGLState.setPolygonOffset(true, -1.0f, -1.0f);
+		break;
+	case kPassSky:
+		// 在相机内部看立方体，不剔除；深度为1的天空只留在清屏后没有被覆盖的像素上
+		gGLState.setDepthTest(true);
+		gGLState.setDepthFunc(GL_LEQUAL);
+		gGLState.setDepthMask(false);
+		gGLState.setCullFace(false);
+		gGLState.setBlend(false);
+		gGLState.setPolygonOffset(false);
+		break;
+	case kPassHud:
+		gGLState.setDepthTest(true);
+		gGLState.setDepthFunc(GL_LESS);
+		gGLState.setDepthMask(true);
+		gGLState.setBlend(false);
+		gGLState.setPolygonOffset(false);
+		break;
+	case kPassTransparent:
+		gGLState.setDepthTest(true);
+		gGLState.setDepthFunc(GL_LESS);
+		gGLState.setDepthMask(false);
+		gGLState.setBlend(true);
+		if (gReducedTransparency.isEnabled()) {
+			// 低分辨率目标清空为透明：颜色累积为预乘颜色，透明度累积为覆盖率
+			gGLState.setBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		else {
+			gGLState.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+		gGLState.setPolygonOffset(false);
+		break;
+	}
+}
 
-	glBindVertexArray(object.vao);
-
-	glUseProgram(object.program);
-	GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-	GLboolean depthMask = GL_TRUE;
-	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-	bool useBlend = object.alpha < 0.999f;
-	if (useBlend) {
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDepthMask(GL_FALSE);
-	}
- 
-    // 父节点矩阵 * 本节点局部变换矩阵
-	glUniformMatrix4fv( object.modelLocation, 1, GL_FALSE, &modelMatrix[0][0]);
-	glUniformMatrix4fv( object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
-	glUniformMatrix4fv( object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
-	glUniform1i( object.shadowLocation, 0);
-	glUniform1f(object.shadowAlphaLocation, object.shadowAlpha);
-	glUniform1i(object.useLightingLocation, object.useLighting);
-	if (object.useLighting == 1) {
-		glUniform3fv(object.lightPosLocation, 1, &kLightPosition[0]);
-		glUniform3fv(object.lightColorLocation, 1, &kLightColor[0]);
-		glUniform3fv(object.eyePositionLocation, 1, &camera->eye[0]);
-		glUniform1f(object.ambientStrengthLocation, kAmbientStrength);
-		glUniform1f(object.specStrengthLocation, kSpecStrength);
-		glUniform1f(object.shininessLocation, kShininess);
-	}
-	if (static_cast<GLint>(object.colorTintLocation) != -1) {
-		glUniform3fv(object.colorTintLocation, 1, &object.colorTint[0]);
-	}
-	if (static_cast<GLint>(object.alphaLocation) != -1) {
-		glUniform1f(object.alphaLocation, object.alpha);
-	}
-	if (object.useTexture == 1 && object.textureID != 0) {
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, object.textureID);
-		glUniform1i(object.textureLocation, 0);
-		glUniform1i(object.useTextureLocation, 1);
-		glUniform2fv(object.texScaleLocation, 1, &object.texScale[0]);
-		glUniform2fv(object.texOffsetLocation, 1, &object.texOffset[0]);
+void issueDrawCall(const DrawPacket& packet)
+{
+	if (packet.indirect) {
+		gCrowdCulling.drawPart(packet.crowdPart);
+		return;
+	}
+	const GeometryHandle* geometry = packet.geometry;
+	bool instanced = packet.instanceCount > 0;
+	if (geometry->ebo != 0) {
+		const GLvoid* indexOffset = BUFFER_OFFSET(static_cast<size_t>(geometry->first) * sizeof(GLuint));
+		if (instanced) {
+			glDrawElementsInstanced(GL_TRIANGLES, geometry->count, GL_UNSIGNED_INT, indexOffset, packet.instanceCount);
+		}
+		else {
+			glDrawElements(GL_TRIANGLES, geometry->count, GL_UNSIGNED_INT, indexOffset);
+		}
+	}
+	else if (instanced) {
+		glDrawArraysInstanced(GL_TRIANGLES, geometry->first, geometry->count, packet.instanceCount);
 	}
 	else {
-		glUniform1i(object.useTextureLocation, 0);
+		glDrawArrays(GL_TRIANGLES, geometry->first, geometry->count);
+	}
+}
+
+// 深度预渲染的一次绘制：只有位置属性的顶点数组对象（实例化绘制仍使用实例的），不设置材质和纹理
+void drawDepthPacket(const DrawPacket& packet)
+{
+	bool instanced = packet.instanceCount > 0;
+	bindGeometry(instanced ? packet.instanceVao : packet.geometry->positionVao, packet.geometry, packet.color,
+		packet.materialIndex, packet.textureLayer);
+	const ShaderProgram* shader = packet.depthShader;
+	gGLState.useProgram(shader->program);
+	if (packet.crowdPart >= 0) {
+		gSpectatorCrowd.applyPart(shader, packet.crowdPart);
+	}
+	shader->set(kUniformModel, packet.model);
+	issueDrawCall(packet);
+}
+
+void drawPacket(const DrawPacket& packet)
+{
+	bool instanced = packet.instanceCount > 0;
+	bindGeometry(instanced ? packet.instanceVao : packet.geometry->vao, packet.geometry, packet.color, packet.materialIndex,
+		packet.textureLayer);
+	const ShaderProgram* shader = packet.shader;
+	gGLState.useProgram(shader->program);
+	if (packet.crowdPart >= 0) {
+		gSpectatorCrowd.applyPart(shader, packet.crowdPart);
+	}
+
+	// 视图、投影和光照参数在每帧的 uniform block 中，这里只上传模型矩阵和材质
+	shader->set(kUniformModel, packet.model);
+	if (packet.pass == kPassSky) {
+		gGLState.bindTexture(kSkyboxTextureUnit, GL_TEXTURE_CUBE_MAP, packet.textureID);
+	}
+	else if (packet.pass == kPassShadow) {
+		shader->set(kUniformShadowAlpha, packet.shadowAlpha);
+	}
+	else {
+		shader->set(kUniformColorTint, packet.colorTint);
+		shader->set(kUniformAlpha, packet.alpha);
+		if (packet.useTexture == 1) {
+			gGLState.bindTexture(0, GL_TEXTURE_2D_ARRAY, packet.textureID);
+			shader->set(kUniformTexScale, packet.texScale);
+			shader->set(kUniformTexOffset, packet.texOffset);
+		}
 	}
 	// 绘制
-	glDrawArrays(GL_TRIANGLES, 0, mesh->getPoints().size());
-	if (useBlend) {
-		glDepthMask(depthMask);
-		if (!blendEnabled) {
-			glDisable(GL_BLEND);
+	issueDrawCall(packet);
+}
+
+// 低分辨率的半透明结果按深度双边上采样，以预乘颜色混合到场景上
+void compositeReducedTransparency(GLuint colorTexture, GLuint depthTexture, GLuint sceneDepthTexture)
+{
+	gGLState.setDepthTest(false);
+	gGLState.setDepthMask(false);
+	gGLState.setBlend(true);
+	gGLState.setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	gGLState.setPolygonOffset(false);
+	gGLState.useProgram(gUpsampleShader->program);
+	gUpsampleShader->set(kUniformTransparentScale, gReducedTransparency.getLowScale());
+	gUpsampleShader->set(kUniformTransparentSize,
+		glm::vec2(gReducedTransparency.getLowWidth(), gReducedTransparency.getLowHeight()));
+	gGLState.bindTexture(kTransparentColorUnit, GL_TEXTURE_2D, colorTexture);
+	gGLState.bindTexture(kTransparentDepthUnit, GL_TEXTURE_2D, depthTexture);
+	gGLState.bindTexture(kSceneDepthUnit, GL_TEXTURE_2D, sceneDepthTexture);
+	gGLState.bindVertexArray(gFullscreenVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// 第 view 个视图在 width x height 的目标中的区域，分屏时左右并排
+void setViewViewport(int view, int width, int height)
+{
+	int left = width * view / gViewCount;
+	int right = width * (view + 1) / gViewCount;
+	glViewport(left, 0, right - left, height);
+}
+
+// 切换到一个视图：绑定它的 FrameData 区间和视口
+void bindView(int view, int width, int height)
+{
+	gFrameUniforms.bind(view);
+	setViewViewport(view, width, height);
+}
+
+bool isPacketInView(const DrawPacket& packet, int view)
+{
+	return (packet.viewMask & (1u << view)) != 0;
+}
+
+// 一个阶段的绘制包依次提交到每个视图
+void drawPassPackets(size_t begin, size_t end, int width, int height)
+{
+	for (int view = 0; view < gViewCount; view++) {
+		bindView(view, width, height);
+		for (size_t i = begin; i < end; i++) {
+			if (isPacketInView(gRenderQueue[i], view)) {
+				drawPacket(gRenderQueue[i]);
+			}
+		}
+	}
+}
+
+// 排序后的队列中某一阶段的绘制包区间 [begin, end)，没有时 begin == end
+void findPassRange(RenderPass pass, size_t& begin, size_t& end)
+{
+	begin = 0;
+	while (begin < gRenderQueue.size() && gRenderQueue[begin].pass < pass) {
+		begin++;
+	}
+	end = begin;
+	while (end < gRenderQueue.size() && gRenderQueue[end].pass == pass) {
+		end++;
+	}
+}
+
+// 按本帧的设置声明渲染通道，由帧图剔除没有用到的通道、分配临时纹理后依次执行
+void submitRenderQueue()
+{
+	gRenderQueue.sort();
+	gFrameGraph.reset();
+	// 场景的尺寸随动态分辨率变化；低分辨率半透明目标按窗口尺寸分配，只使用其中场景大小的区域
+	int sceneWidth = gDynamicResolution.getSceneWidth();
+	int sceneHeight = gDynamicResolution.getSceneHeight();
+	gReducedTransparency.setSceneSize(sceneWidth, sceneHeight);
+	GLuint sceneFramebuffer = gDynamicResolution.getSceneFramebuffer();
+
+	// 场景缓冲由动态分辨率持有，未开启时就是默认帧缓冲
+	FrameResource sceneColor = gFrameGraph.importFramebuffer("scene color", sceneFramebuffer);
+	FrameResource sceneDepth = gFrameGraph.importFramebuffer("scene depth", sceneFramebuffer);
+	FrameResource backbufferColor = sceneColor;
+	FrameResource backbufferDepth = sceneDepth;
+	if (gDynamicResolution.isSceneOffscreen()) {
+		backbufferColor = gFrameGraph.importFramebuffer("backbuffer color", 0);
+		backbufferDepth = gFrameGraph.importFramebuffer("backbuffer depth", 0);
+	}
+	gFrameGraph.markOutput(backbufferColor);
+
+	size_t opaqueBegin, opaqueEnd;
+	findPassRange(kPassOpaque, opaqueBegin, opaqueEnd);
+	// 先关闭颜色写入画一遍深度
+	if (gQuality.depthPrepass && opaqueBegin < opaqueEnd) {
+		int pass = gFrameGraph.addPass("depth prepass", [=]() {
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+			gGLState.setDepthTest(true);
+			gGLState.setDepthFunc(GL_LESS);
+			gGLState.setDepthMask(true);
+			gGLState.setBlend(false);
+			gGLState.setPolygonOffset(false);
+			gGLState.setColorMask(false);
+			for (int view = 0; view < gViewCount; view++) {
+				bindView(view, sceneWidth, sceneHeight);
+				for (size_t i = opaqueBegin; i < opaqueEnd; i++) {
+					if (isPacketInView(gRenderQueue[i], view)) {
+						drawDepthPacket(gRenderQueue[i]);
+					}
+				}
+			}
+			gGLState.setColorMask(true);
+		});
+		gFrameGraph.write(pass, sceneDepth);
+	}
+
+	// 不透明物体、平面阴影和天空盒都画在场景缓冲上
+	static const RenderPass kScenePasses[] = { kPassOpaque, kPassShadow, kPassSky };
+	static const char* kScenePassNames[] = { "opaque", "shadow", "sky" };
+	for (int i = 0; i < 3; i++) {
+		RenderPass renderPass = kScenePasses[i];
+		size_t begin, end;
+		findPassRange(renderPass, begin, end);
+		if (begin == end) {
+			continue;
+		}
+		int pass = gFrameGraph.addPass(kScenePassNames[i], [=]() {
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+			applyPassState(renderPass);
+			drawPassPackets(begin, end, sceneWidth, sceneHeight);
+		});
+		gFrameGraph.read(pass, sceneDepth);
+		gFrameGraph.write(pass, sceneColor);
+		if (renderPass != kPassSky) {
+			gFrameGraph.write(pass, sceneDepth);
 		}
 	}
+
+	size_t transparentBegin, transparentEnd;
+	findPassRange(kPassTransparent, transparentBegin, transparentEnd);
+	if (gReducedTransparency.isEnabled()) {
+		// 深度的缩小总是声明，没有半透明物体时没有通道读取它的结果，由帧图剔除
+		FrameResource sceneDepthCopy = gFrameGraph.createTexture("scene depth copy", gReducedTransparency.getSceneDepthDesc());
+		FrameResource lowDepth = gFrameGraph.createTexture("transparent depth", gReducedTransparency.getDepthDesc());
+		FrameResource lowColor = gFrameGraph.createTexture("transparent color", gReducedTransparency.getColorDesc());
+		int downsample = gFrameGraph.addPass("transparent depth downsample", [=]() {
+			gReducedTransparency.downsampleDepth(sceneFramebuffer,
+				gFrameGraph.getFramebuffer(kInvalidFrameResource, sceneDepthCopy),
+				gFrameGraph.getFramebuffer(kInvalidFrameResource, lowDepth));
+		});
+		gFrameGraph.read(downsample, sceneDepth);
+		gFrameGraph.write(downsample, sceneDepthCopy);
+		gFrameGraph.write(downsample, lowDepth);
+
+		if (transparentBegin < transparentEnd) {
+			int lowWidth = gReducedTransparency.getLowWidth();
+			int lowHeight = gReducedTransparency.getLowHeight();
+			int transparent = gFrameGraph.addPass("transparent (reduced)", [=]() {
+				glBindFramebuffer(GL_FRAMEBUFFER, gFrameGraph.getFramebuffer(lowColor, lowDepth));
+				// 不改变场景的清屏颜色
+				const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				glClearBufferfv(GL_COLOR, 0, clearColor);
+				applyPassState(kPassTransparent);
+				drawPassPackets(transparentBegin, transparentEnd, lowWidth, lowHeight);
+			});
+			gFrameGraph.read(transparent, lowDepth);
+			gFrameGraph.write(transparent, lowColor);
+
+			// 一次合成覆盖所有视图
+			int composite = gFrameGraph.addPass("transparent composite", [=]() {
+				glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+				glViewport(0, 0, sceneWidth, sceneHeight);
+				compositeReducedTransparency(gFrameGraph.getTexture(lowColor), gFrameGraph.getTexture(lowDepth),
+					gFrameGraph.getTexture(sceneDepthCopy));
+			});
+			gFrameGraph.read(composite, lowColor);
+			gFrameGraph.read(composite, lowDepth);
+			gFrameGraph.read(composite, sceneDepthCopy);
+			gFrameGraph.write(composite, sceneColor);
+		}
+	}
+	else if (transparentBegin < transparentEnd) {
+		int transparent = gFrameGraph.addPass("transparent", [=]() {
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+			applyPassState(kPassTransparent);
+			drawPassPackets(transparentBegin, transparentEnd, sceneWidth, sceneHeight);
+		});
+		gFrameGraph.read(transparent, sceneDepth);
+		gFrameGraph.write(transparent, sceneColor);
+	}
+
+	// 场景放大到窗口，之后 HUD 以原生分辨率绘制
+	if (gDynamicResolution.isSceneOffscreen()) {
+		int resolve = gFrameGraph.addPass("resolve", []() {
+			gDynamicResolution.resolveScene();
+		});
+		gFrameGraph.read(resolve, sceneColor);
+		gFrameGraph.read(resolve, sceneDepth);
+		gFrameGraph.write(resolve, backbufferColor);
+		gFrameGraph.write(resolve, backbufferDepth);
+	}
+
+	size_t hudBegin, hudEnd;
+	findPassRange(kPassHud, hudBegin, hudEnd);
+	if (hudBegin < hudEnd) {
+		GLuint hudFramebuffer = gFrameGraph.getFramebuffer(backbufferColor);
+		int hud = gFrameGraph.addPass("hud", [=]() {
+			glBindFramebuffer(GL_FRAMEBUFFER, hudFramebuffer);
+			applyPassState(kPassHud);
+			drawPassPackets(hudBegin, hudEnd, WIDTH, HEIGHT);
+		});
+		gFrameGraph.read(hud, backbufferDepth);
+		gFrameGraph.write(hud, backbufferColor);
+		gFrameGraph.write(hud, backbufferDepth);
+	}
+
+	// 新建临时纹理时绕过了状态缓存
+	if (gFrameGraph.compile()) {
+		gGLState.invalidate();
+	}
+	gFrameGraph.execute();
+
+	// glClear 受深度写入开关影响，提交结束后恢复默认状态
+	applyPassState(kPassOpaque);
+	gGLState.setDepthFunc(GL_LESS);
+	gGLState.setDepthMask(true);
+	gLastFrameDrawCount = gRenderQueue.size();
+	gRenderQueue.clear();
 }
 
 void drawMeshWithShadow(glm::mat4 modelMatrix, TriMesh* mesh, openGLObject object, float shadowPlaneY, bool castShadow)
@@ -449,10 +933,11 @@ void drawMeshWithShadow(glm::mat4 modelMatrix, TriMesh* mesh, openGLObject objec
 
 void drawSwimRing(glm::mat4 modelMatrix, float shadowPlaneY, bool castShadow)
 {
-	const int segments = 16;
+	const int segments = gQuality.swimRingSegments;
 	const float ringRadius = 1.0f;
 	const float tubeRadius = 0.25f;
-	const float segmentLength = tubeRadius * 2.5f;
+	// 分段之间略有重叠，16段时与原来的长度相同
+	const float segmentLength = 1.6f * 2.0f * 3.1415926f * ringRadius / static_cast<float>(segments);
 	for (int i = 0; i < segments; ++i) {
 		float angle = 360.0f * static_cast<float>(i) / static_cast<float>(segments);
 		glm::mat4 segment = glm::rotate(modelMatrix, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -789,15 +1274,15 @@ void drawSwimmerRobot(glm::mat4 modelMatrix, const glm::vec3& tint, float upperA
 	modelMatrix = mstack.pop();
 }
 
-glm::mat4 makeBillboardMatrix(const glm::vec3& position)
+glm::mat4 makeBillboardMatrix(const glm::vec3& position, const Camera* viewCamera)
 {
-	glm::vec3 forward = glm::vec3(camera->at) - glm::vec3(camera->eye);
+	glm::vec3 forward = glm::vec3(viewCamera->at) - glm::vec3(viewCamera->eye);
 	if (glm::length(forward) < 0.001f) {
 		forward = glm::vec3(0.0f, 0.0f, -1.0f);
 	}
 	forward = glm::normalize(forward);
 	glm::vec3 zAxis = -forward;
-	glm::vec3 up = glm::normalize(glm::vec3(camera->up));
+	glm::vec3 up = glm::normalize(glm::vec3(viewCamera->up));
 	if (std::abs(glm::dot(up, zAxis)) > 0.99f) {
 		up = glm::vec3(0.0f, 0.0f, 1.0f);
 	}
@@ -810,7 +1295,8 @@ glm::mat4 makeBillboardMatrix(const glm::vec3& position)
 	return glm::translate(glm::mat4(1.0f), position) * rotation;
 }
 
-void drawPlayerNumber(const glm::mat4& modelMatrix, const glm::vec3& position, int number, const glm::vec3& tint)
+void drawPlayerNumber(const glm::mat4& modelMatrix, const glm::vec3& position, int number, const glm::vec3& tint,
+	const Camera* viewCamera)
 {
 	static const bool kSegments[10][7] = {
 		{ true,  true,  true,  false, true,  true,  true  }, // 0
@@ -841,9 +1327,12 @@ void drawPlayerNumber(const glm::mat4& modelMatrix, const glm::vec3& position, i
 	float vertLen = height * 0.5f - thickness * 0.5f;
 
 	glm::vec3 worldPos = glm::vec3(modelMatrix * glm::vec4(position, 1.0f));
-	glm::mat4 base = makeBillboardMatrix(worldPos);
+	glm::mat4 base = makeBillboardMatrix(worldPos, viewCamera);
+	// 编号属于 HUD，动态分辨率时也以原生分辨率绘制
 	auto drawSegment = [&](const glm::vec3& offset, const glm::vec3& scale) {
-		drawScaledMesh(base, Torso, digitObject, offset, scale);
+		glm::mat4 instance = glm::translate(glm::mat4(1.0f), offset);
+		instance = glm::scale(instance, scale);
+		queueDraw(kPassHud, base * instance, digitObject);
 	};
 
 	if (kSegments[number][0]) {
@@ -898,37 +1387,16 @@ glm::mat4 shadowMatrixYPlane(float planeY, const glm::vec3& lightPos)
 
 void drawShadowMesh(glm::mat4 modelMatrix, TriMesh* mesh, openGLObject object, float planeY)
 {
+	if (!gQuality.planarShadows) {
+		return;
+	}
 	glm::mat4 shadowMatrix = shadowMatrixYPlane(planeY, kLightPosition);
 	glm::mat4 shadowModel = shadowMatrix * modelMatrix;
-
-	GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-	GLboolean depthEnabled = glIsEnabled(GL_DEPTH_TEST);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_POLYGON_OFFSET_FILL);
-	glPolygonOffset(-1.0f, -1.0f);
-
-	glBindVertexArray(object.vao);
-	glUseProgram(object.program);
-
-	glUniformMatrix4fv(object.modelLocation, 1, GL_FALSE, &shadowModel[0][0]);
-	glUniformMatrix4fv(object.viewLocation, 1, GL_FALSE, &camera->viewMatrix[0][0]);
-	glUniformMatrix4fv(object.projectionLocation, 1, GL_FALSE, &camera->projMatrix[0][0]);
-	glUniform1i(object.shadowLocation, 1);
-	glUniform1f(object.shadowAlphaLocation, object.shadowAlpha);
-	glUniform1i(object.useLightingLocation, 0);
-	glUniform1i(object.useTextureLocation, 0);
-
-	glDrawArrays(GL_TRIANGLES, 0, mesh->getPoints().size());
-
-	glDisable(GL_POLYGON_OFFSET_FILL);
-	if (!blendEnabled) {
-		glDisable(GL_BLEND);
-	}
-	if (!depthEnabled) {
-		glDisable(GL_DEPTH_TEST);
+	if (gStaticCapture != NULL) {
+		gStaticCapture->add(makePacket(kPassShadow, shadowModel, object), mesh);
+		return;
 	}
+	queueDraw(kPassShadow, shadowModel, object);
 }
 
 void ground_plane(glm::mat4 modelMatrix)
@@ -958,7 +1426,6 @@ void campus_walls(glm::mat4 modelMatrix)
 	float wallCenterY = groundTopY + 0.5f * kCampusWallHeight;
 	float wallLength = campusHalf * 2.0f + kCampusWallThickness * 2.0f;
 	openGLObject wallObject = CampusWallObject;
-	wallObject.texScale = glm::vec2(wallLength / 8.0f, kCampusWallHeight / 8.0f);
 
 	drawScaledMesh(
 		modelMatrix,
@@ -1010,68 +1477,206 @@ void pool_lane_floats(glm::mat4 modelMatrix)
 	}
 }
 
-void pool_spectator_stands(glm::mat4 modelMatrix)
+// 看台台阶的尺寸，台阶和观众布局共用
+const int kStandStepCount = 5;
+const float kStandStepHeight = 10.0f;
+const float kStandStepDepth = 30.0f;
+const int kSpectatorColumns = 12;
+const float kSpectatorScale = 2.5f;
+
+float getStandBaseOffsetZ()
+{
+	return poolScene.POOL_WIDTH * 0.5f + poolScene.WALL_THICKNESS + 2.0f;
+}
+
+// 生成所有观众的位置、颜色和动画相位，结果只与场景尺寸有关
+void buildSpectatorLayout(std::vector<CrowdInstance>& instances)
 {
+	instances.clear();
 	float groundTopY = -poolScene.GROUND_DROP;
-	float wall = poolScene.WALL_THICKNESS;
-	float standLength = poolScene.POOL_LENGTH + 20.0f;
-	int stepCount = 5;
-	float stepHeight = 10;
-	float stepDepth = 30;
-	float baseOffsetZ = poolScene.POOL_WIDTH * 0.5f + wall + 2.0f;
-	float robotScale = 2.5f;
+	float baseOffsetZ = getStandBaseOffsetZ();
 
 	for (int side = 0; side < 2; ++side) {
 		float zSign = side == 0 ? 1.0f : -1.0f;
-		int cols = 12;
+		int cols = kSpectatorColumns;
 		float spanX = poolScene.POOL_LENGTH * 0.85f;
 		float startX = -spanX * 0.5f;
 		float colStep = spanX / static_cast<float>(cols - 1);
 
-		for (int step = 0; step < stepCount; ++step) {
-			float stepCenterY = groundTopY + stepHeight * 0.5f + stepHeight * step;
-			float stepCenterZ = baseOffsetZ + stepDepth * (step + 0.5f);
-			drawScaledMesh(
-				modelMatrix,
-				SpectatorStand,
-				SpectatorStandObject,
-				glm::vec3(0.0f, stepCenterY, zSign * stepCenterZ),
-				glm::vec3(standLength, stepHeight, stepDepth));
-
-			float stepTopY = groundTopY + stepHeight * (step + 1.0f);
-			float rowZ = stepCenterZ - stepDepth * 0.35f;
+		for (int step = 0; step < kStandStepCount; ++step) {
+			float stepCenterZ = baseOffsetZ + kStandStepDepth * (step + 0.5f);
+			float stepTopY = groundTopY + kStandStepHeight * (step + 1.0f);
+			float rowZ = stepCenterZ - kStandStepDepth * 0.35f;
 			for (int col = 0; col < cols; ++col) {
 				unsigned int seed = static_cast<unsigned int>(side * 100000 + step * 1000 + col);
+				// 按画质设置的密度保留一部分观众，同一密度下留下的总是同一批
+				if (hash01(seed + 53u) >= gQuality.crowdDensity) {
+					continue;
+				}
 				float jitterX = (hash01(seed + 5u) - 0.5f) * 0.6f;
 				float jitterZ = (hash01(seed + 11u) - 0.5f) * 0.4f;
 				float staggerX = (col % 2 == 0) ? -0.2f : 0.2f;
 				float staggerZ = (step % 2 == 0) ? -0.15f : 0.15f;
 				float x = startX + col * colStep + jitterX + staggerX;
 				float z = rowZ + jitterZ + staggerZ;
-				glm::vec3 tint(
+
+				CrowdInstance instance;
+				instance.positionScale = glm::vec4(x, stepTopY + 0.02f, zSign * z, kSpectatorScale);
+				instance.tintPhase = glm::vec4(
 					0.3f + 0.7f * hash01(seed + 17u),
 					0.3f + 0.7f * hash01(seed + 23u),
-					0.3f + 0.7f * hash01(seed + 31u));
-				glm::vec3 worldPos(x, stepTopY + 0.02f, zSign * z);
-				glm::vec3 toPlayer = glm::vec3(gRobotPosition.x - worldPos.x, 0.0f, gRobotPosition.z - worldPos.z);
-				float yaw = 0.0f;
-				if (glm::length(toPlayer) > 0.001f) {
-					yaw = glm::degrees(std::atan2(toPlayer.x, -toPlayer.z));
-				}
-				float cheerPhase = static_cast<float>(glfwGetTime()) * 4.0f + hash01(seed + 41u) * 6.28318f;
-				float cheer = std::sin(cheerPhase);
-				float upperArmAngle = 60.0f + 25.0f * cheer;
-				float lowerArmAngle = 20.0f + 15.0f * cheer;
-
-				glm::mat4 robotMatrix = glm::translate(modelMatrix, worldPos);
-				robotMatrix = glm::rotate(robotMatrix, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-				robotMatrix = glm::scale(robotMatrix, glm::vec3(robotScale));
-				drawSpectatorRobot(robotMatrix, tint, -upperArmAngle, -lowerArmAngle, groundTopY, true);
+					0.3f + 0.7f * hash01(seed + 31u),
+					hash01(seed + 41u) * 6.28318f);
+				instances.push_back(instance);
 			}
 		}
 	}
 }
 
+// 观众身体各部位的关节链，与 drawSpectatorRobot 中的变换一致
+void setupSpectatorCrowd()
+{
+	auto localMatrix = [](float centerY, float width, float height) {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, centerY, 0.0f));
+		return glm::scale(local, glm::vec3(width, height, width));
+	};
+	auto addPart = [&](openGLObject& object, const glm::vec3& pivot, const glm::vec3& childOffset,
+		const glm::vec2& swing, const glm::mat4& local) {
+		int index = gSpectatorCrowd.addPart(object.geometry, pivot, childOffset, swing, local);
+		gCrowdPartObjects[index] = &object;
+	};
+
+	glm::vec3 zero(0.0f);
+	glm::vec3 leftShoulder(-0.5f * robot.TORSO_WIDTH - 0.5f * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0f);
+	glm::vec3 rightShoulder(0.5f * robot.TORSO_WIDTH + 0.5f * robot.UPPER_ARM_WIDTH, robot.TORSO_HEIGHT, 0.0f);
+	glm::vec3 elbow(0.0f, -robot.UPPER_ARM_HEIGHT, 0.0f);
+	glm::vec3 leftHip(-0.5f * robot.TORSO_WIDTH + 0.5f * robot.UPPER_LEG_WIDTH, 0.0f, 0.0f);
+	glm::vec3 rightHip(0.5f * robot.TORSO_WIDTH - 0.5f * robot.UPPER_LEG_WIDTH, 0.0f, 0.0f);
+	glm::vec3 knee(0.0f, -robot.UPPER_LEG_HEIGHT, 0.0f);
+	glm::mat4 upperArm = localMatrix(-0.5f * robot.UPPER_ARM_HEIGHT, robot.UPPER_ARM_WIDTH, robot.UPPER_ARM_HEIGHT);
+	glm::mat4 lowerArm = localMatrix(-0.5f * robot.LOWER_ARM_HEIGHT, robot.LOWER_ARM_WIDTH, robot.LOWER_ARM_HEIGHT);
+	glm::mat4 upperLeg = localMatrix(-0.5f * robot.UPPER_LEG_HEIGHT, robot.UPPER_LEG_WIDTH, robot.UPPER_LEG_HEIGHT);
+	glm::mat4 lowerLeg = localMatrix(-0.5f * robot.LOWER_LEG_HEIGHT, robot.LOWER_LEG_WIDTH, robot.LOWER_LEG_HEIGHT);
+
+	addPart(TorsoObject, zero, zero, glm::vec2(0.0f),
+		localMatrix(0.5f * robot.TORSO_HEIGHT, robot.TORSO_WIDTH, robot.TORSO_HEIGHT));
+	addPart(HeadObject, glm::vec3(0.0f, robot.TORSO_HEIGHT, 0.0f), zero, glm::vec2(0.0f),
+		localMatrix(0.5f * robot.HEAD_HEIGHT, robot.HEAD_WIDTH, robot.HEAD_HEIGHT));
+	// 左右手臂摆动方向相反
+	addPart(LeftUpperArmObject, leftShoulder, zero, glm::vec2(1.0f, 0.0f), upperArm);
+	addPart(LeftLowerArmObject, leftShoulder, elbow, glm::vec2(1.0f, 1.0f), lowerArm);
+	addPart(RightUpperArmObject, rightShoulder, zero, glm::vec2(-1.0f, 0.0f), upperArm);
+	addPart(RightLowerArmObject, rightShoulder, elbow, glm::vec2(-1.0f, -1.0f), lowerArm);
+	addPart(LeftUpperLegObject, leftHip, zero, glm::vec2(0.0f), upperLeg);
+	addPart(LeftLowerLegObject, leftHip, knee, glm::vec2(0.0f), lowerLeg);
+	addPart(RightUpperLegObject, rightHip, zero, glm::vec2(0.0f), upperLeg);
+	addPart(RightLowerLegObject, rightHip, knee, glm::vec2(0.0f), lowerLeg);
+
+	buildSpectatorLayout(gSpectatorLayout);
+	gSpectatorCrowd.setInstances(gSpectatorLayout);
+}
+
+// 观众局部坐标中的包围球，包括举起和张开的双臂
+void getSpectatorBounds(float& centerY, float& radius)
+{
+	float armLength = robot.UPPER_ARM_HEIGHT + robot.LOWER_ARM_HEIGHT;
+	float top = robot.TORSO_HEIGHT + std::max(robot.HEAD_HEIGHT, armLength);
+	float bottom = -(robot.UPPER_LEG_HEIGHT + robot.LOWER_LEG_HEIGHT);
+	float halfWidth = 0.5f * robot.TORSO_WIDTH + robot.UPPER_ARM_WIDTH + armLength;
+	centerY = 0.5f * (top + bottom);
+	radius = glm::length(glm::vec2(halfWidth, 0.5f * (top - bottom)));
+}
+
+bool isGpuCrowdCullingActive()
+{
+	return gInstancedCrowd && gGpuCrowdCulling && gCrowdCulling.isSupported();
+}
+
+// 每个身体部位对整个人群只生成一个颜色绘制包和一个阴影绘制包
+void queueSpectatorCrowd(const glm::mat4& modelMatrix, float shadowPlaneY)
+{
+	if (gSpectatorCrowd.getInstanceCount() == 0) {
+		return;
+	}
+	gSpectatorCrowd.setFrame(static_cast<float>(glfwGetTime()), gRobotPosition);
+	bool culled = isGpuCrowdCullingActive();
+	glm::mat4 shadowModel = shadowMatrixYPlane(shadowPlaneY, kLightPosition) * modelMatrix;
+
+	for (int i = 0; i < gSpectatorCrowd.getPartCount(); i++) {
+		const CrowdPart& part = gSpectatorCrowd.getPart(i);
+		openGLObject object = *gCrowdPartObjects[i];
+		// 观众颜色来自实例数据
+		object.colorTint = glm::vec3(1.0f, 1.0f, 1.0f);
+
+		DrawPacket packet = makePacket(kPassOpaque, modelMatrix, object, kShaderCrowdInstancing);
+		packet.instanceVao = culled ? gCrowdCulling.getPartVertexArray(i) : part.vao;
+		packet.instanceCount = gSpectatorCrowd.getInstanceCount();
+		packet.crowdPart = i;
+		packet.indirect = culled;
+		gRecordQueue->push(packet);
+
+		if (!gQuality.planarShadows) {
+			continue;
+		}
+		DrawPacket shadow = makePacket(kPassShadow, shadowModel, object, kShaderCrowdInstancing);
+		shadow.instanceVao = packet.instanceVao;
+		shadow.instanceCount = gSpectatorCrowd.getInstanceCount();
+		shadow.crowdPart = i;
+		shadow.indirect = culled;
+		gRecordQueue->push(shadow);
+	}
+}
+
+void pool_stand_steps(glm::mat4 modelMatrix)
+{
+	float groundTopY = -poolScene.GROUND_DROP;
+	float standLength = poolScene.POOL_LENGTH + 20.0f;
+	float baseOffsetZ = getStandBaseOffsetZ();
+
+	for (int side = 0; side < 2; ++side) {
+		float zSign = side == 0 ? 1.0f : -1.0f;
+		for (int step = 0; step < kStandStepCount; ++step) {
+			float stepCenterY = groundTopY + kStandStepHeight * 0.5f + kStandStepHeight * step;
+			float stepCenterZ = baseOffsetZ + kStandStepDepth * (step + 0.5f);
+			drawScaledMesh(
+				modelMatrix,
+				SpectatorStand,
+				SpectatorStandObject,
+				glm::vec3(0.0f, stepCenterY, zSign * stepCenterZ),
+				glm::vec3(standLength, kStandStepHeight, kStandStepDepth));
+		}
+	}
+}
+
+void pool_spectators(glm::mat4 modelMatrix)
+{
+	float groundTopY = -poolScene.GROUND_DROP;
+	if (gInstancedCrowd) {
+		queueSpectatorCrowd(modelMatrix, groundTopY);
+		return;
+	}
+
+	// 逐个观众绘制，用于和实例化结果对照
+	for (const CrowdInstance& instance : gSpectatorLayout) {
+		glm::vec3 worldPos(instance.positionScale);
+		glm::vec3 tint(instance.tintPhase);
+		glm::vec3 toPlayer = glm::vec3(gRobotPosition.x - worldPos.x, 0.0f, gRobotPosition.z - worldPos.z);
+		float yaw = 0.0f;
+		if (glm::length(toPlayer) > 0.001f) {
+			yaw = glm::degrees(std::atan2(toPlayer.x, -toPlayer.z));
+		}
+		float cheerPhase = static_cast<float>(glfwGetTime()) * 4.0f + instance.tintPhase.w;
+		float cheer = std::sin(cheerPhase);
+		float upperArmAngle = 60.0f + 25.0f * cheer;
+		float lowerArmAngle = 20.0f + 15.0f * cheer;
+
+		glm::mat4 robotMatrix = glm::translate(modelMatrix, worldPos);
+		robotMatrix = glm::rotate(robotMatrix, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+		robotMatrix = glm::scale(robotMatrix, glm::vec3(instance.positionScale.w));
+		drawSpectatorRobot(robotMatrix, tint, -upperArmAngle, -lowerArmAngle, groundTopY, true);
+	}
+}
+
 void drawAiSwimmers(glm::mat4 modelMatrix)
 {
 	if (gAiSwimmers.empty()) {
@@ -1131,6 +1736,12 @@ void pool_basin(glm::mat4 modelMatrix)
 		glm::vec3(-wallX, wallCenterY, 0.0),
 		glm::vec3(wall, wallHeight, shortWidth));
 
+	pool_lane_floats(modelMatrix);
+}
+
+// 水面的纹理偏移每帧变化，不参与静态合批
+void pool_water(glm::mat4 modelMatrix)
+{
 	float waterCenterY = -poolScene.WATER_THICKNESS * 0.5 - 0.05;
 	openGLObject waterObject = PoolWaterObject;
 	float waterTime = static_cast<float>(glfwGetTime());
@@ -1142,8 +1753,6 @@ void pool_basin(glm::mat4 modelMatrix)
 		waterObject,
 		glm::vec3(0.0, waterCenterY, 0.0),
 		glm::vec3(poolScene.POOL_LENGTH, poolScene.WATER_THICKNESS, poolScene.POOL_WIDTH));
-
-	pool_lane_floats(modelMatrix);
 }
 
 void pool_ladder_rail(glm::mat4 modelMatrix)
@@ -1190,12 +1799,9 @@ void pool_ladder(glm::mat4 modelMatrix)
 	modelMatrix = mstack.pop();
 }
 
-void pool_scene(glm::mat4 modelMatrix)
+// 不会移动的泳池部分：池壁、分道线浮标、池边、看台台阶和扶梯
+void pool_static_geometry(glm::mat4 modelMatrix)
 {
-	MatrixStack mstack;
-	modelMatrix = glm::translate(modelMatrix, poolScene.position);
-	mstack.push(modelMatrix);
-
 	float wall = poolScene.WALL_THICKNESS;
 	float border = poolScene.DECK_BORDER;
 	float deckThickness = poolScene.DECK_THICKNESS;
@@ -1217,7 +1823,7 @@ void pool_scene(glm::mat4 modelMatrix)
 		DeckObject,
 		glm::vec3(-deckX, deckY, 0.0f),
 		glm::vec3(border, deckThickness, innerWidth));
-	pool_spectator_stands(modelMatrix);
+	pool_stand_steps(modelMatrix);
 
 	glm::mat4 ladderMatrix = glm::translate(
 		modelMatrix,
@@ -1225,6 +1831,49 @@ void pool_scene(glm::mat4 modelMatrix)
 	pool_ladder(ladderMatrix);
 	float groundTopY = -poolScene.GROUND_DROP;
 	drawShadowMesh(ladderMatrix, Ladder, LadderObject, groundTopY);
+}
+
+glm::mat4 getPoolSceneMatrix()
+{
+	return glm::translate(glm::mat4(1.0f), poolScene.position);
+}
+
+// 在初始化时把静态部分变换到世界坐标并按材质合并，需要在纹理加载之后调用
+void buildStaticBatch()
+{
+	gStaticBatch.begin();
+	gStaticCapture = &gStaticBatch;
+	pool_static_geometry(getPoolSceneMatrix());
+	gStaticCapture = NULL;
+	gStaticBatch.end();
+	gGLState.invalidateVertexArray();
+}
+
+void queueStaticBatch()
+{
+	for (int i = 0; i < gStaticBatch.getGroupCount(); i++) {
+		DrawPacket packet = gStaticBatch.getGroup(i);
+		packet.key = RenderQueue::makeKey(packet.pass, packet.shader->program, packet.textureID, 0.0f);
+		gRecordQueue->push(packet);
+	}
+}
+
+void pool_scene(glm::mat4 modelMatrix)
+{
+	MatrixStack mstack;
+	modelMatrix = modelMatrix * getPoolSceneMatrix();
+	mstack.push(modelMatrix);
+
+	// 合批结果已经包含了泳池的位置，只在父节点变换为单位矩阵时可以直接使用，否则逐个绘制
+	bool batchValid = modelMatrix == getPoolSceneMatrix();
+	if (gUseStaticBatch && gStaticBatch.isBuilt() && batchValid) {
+		queueStaticBatch();
+	}
+	else {
+		pool_static_geometry(modelMatrix);
+	}
+	pool_water(modelMatrix);
+	// 观众在单独的记录任务中，见 recordCrowd
 
 	modelMatrix = mstack.pop();
 }
@@ -1315,7 +1964,8 @@ void appendTextureLog(const std::string& message)
 	}
 }
 
-GLuint loadTexture2D(const std::string& filename)
+// 资源文件的实际路径：Windows 下从可执行文件所在目录向上查找
+std::string resolveAssetPath(const std::string& filename)
 {
 	std::string resolvedPath = filename;
 #ifdef _WIN32
@@ -1336,6 +1986,13 @@ GLuint loadTexture2D(const std::string& filename)
 	}
 	appendTextureLog("Exe dir: " + wideToUtf8(exeDir));
 #endif
+	return resolvedPath;
+}
+
+// 读取图片并加入尺寸相同的纹理数组；读取失败时返回的层号为 -1
+TextureArraySet::Layer loadTextureLayer(TextureArraySet& textures, const std::string& filename)
+{
+	std::string resolvedPath = resolveAssetPath(filename);
 	appendTextureLog("Try load texture: " + resolvedPath);
 	int width = 0;
 	int height = 0;
@@ -1352,7 +2009,7 @@ GLuint loadTexture2D(const std::string& filename)
 		if (gWindow) {
 			glfwSetWindowTitle(gWindow, "Texture load failed");
 		}
-		return 0;
+		return TextureArraySet::Layer();
 	}
 	std::stringstream ss;
 	ss << "Loaded texture: " << resolvedPath << " (" << width << "x" << height << ")";
@@ -1361,34 +2018,59 @@ GLuint loadTexture2D(const std::string& filename)
 		glfwSetWindowTitle(gWindow, "Texture loaded");
 	}
 
-	GLenum format = GL_RGB;
-	if (channels == 1) {
-		format = GL_RED;
+	TextureArraySet::Layer layer = textures.addLayer(data, width, height, channels);
+	stbi_image_free(data);
+	return layer;
+}
+
+// 天空盒：有 3x2 网格图时从中切出六个面，否则读取六张单独的图片
+void loadSkybox()
+{
+	std::string gridPath = resolveAssetPath(u8"assets/skybox_grid.jpg");
+	if (std::ifstream(gridPath).good() && gSkybox.loadGrid(gridPath, kCubemapGrid3x2Layout)) {
+		appendTextureLog("Loaded skybox grid: " + gridPath);
+		return;
 	}
-	else if (channels == 4) {
-		format = GL_RGBA;
+	std::string facePaths[kCubeFaceCount];
+	facePaths[kCubeRight] = resolveAssetPath(u8"assets/skybox_right.jpg");
+	facePaths[kCubeLeft] = resolveAssetPath(u8"assets/skybox_left.jpg");
+	facePaths[kCubeTop] = resolveAssetPath(u8"assets/skybox_top.jpg");
+	facePaths[kCubeBottom] = resolveAssetPath(u8"assets/skybox_bottom.jpg");
+	facePaths[kCubeFront] = resolveAssetPath(u8"assets/skybox_front.jpg");
+	facePaths[kCubeBack] = resolveAssetPath(u8"assets/skybox_back.jpg");
+	if (!gSkybox.loadFaces(facePaths)) {
+		appendTextureLog("Failed to load skybox faces");
 	}
+}
 
-	GLuint textureID = 0;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	stbi_image_free(data);
-	return textureID;
+// 按世界坐标三向投影贴图，纹理每 tileSize 个世界单位重复一次，与物体的缩放无关
+void setObjectTriplanarTexture(openGLObject& object, const TextureArraySet::Layer& layer, float tileSize)
+{
+	object.textureID = gSceneTextures.getTexture(layer);
+	object.textureLayer = layer.layer;
+	object.texScale = glm::vec2(1.0f / tileSize, 1.0f / tileSize);
+	object.useTexture = (object.textureID != 0 && layer.layer >= 0) ? 1 : 0;
+	object.useTriplanar = 1;
 }
 
-void setObjectTexture(openGLObject& object, GLuint textureID, const glm::vec2& texScale)
+// 读取场景贴图并设置到各物体上；尺寸上限改变后贴图可能换到别的纹理数组，重新加载时也重新设置
+void loadSceneTextures()
 {
-	object.textureID = textureID;
-	object.texScale = texScale;
-	object.useTexture = textureID != 0 ? 1 : 0;
+	gSceneTextures.reset(gQuality.textureSize);
+	TextureArraySet::Layer tileTexture = loadTextureLayer(gSceneTextures, u8"assets/pool_ground.jpg");
+	TextureArraySet::Layer waterTexture = loadTextureLayer(gSceneTextures, u8"assets/water.jpg");
+	TextureArraySet::Layer wallTexture = loadTextureLayer(gSceneTextures, u8"assets/walltexture.jpg");
+	gSceneTextures.upload();
+	// 上传时直接绑定了纹理
+	gGLState.invalidate();
+
+	// 程序生成的立方体没有纹理坐标，按世界坐标投影，瓷砖大小与原来的平均密度接近
+	setObjectTriplanarTexture(GroundObject, tileTexture, 100.0f);
+	setObjectTriplanarTexture(DeckObject, tileTexture, 25.0f);
+	setObjectTriplanarTexture(PoolWallObject, tileTexture, 75.0f);
+	setObjectTriplanarTexture(PoolBottomObject, tileTexture, 75.0f);
+	setObjectTriplanarTexture(PoolWaterObject, waterTexture, 100.0f);
+	setObjectTriplanarTexture(CampusWallObject, wallTexture, 8.0f);
 }
 
 glm::vec3 getHeadForward()
@@ -1616,165 +2298,174 @@ void updateRaceState(float deltaTime)
 	}
 }
 
-void updateCameraFollow()
+// 单视图时看向泳池中心；分屏时每个视图以较近的距离看向各自的玩家，distanceScale 缩短相机偏移
+void updateCameraFollow(Camera* target, const glm::vec3& focus, float distanceScale)
 {
 	float horizontal = (std::max)(poolScene.POOL_LENGTH, poolScene.POOL_WIDTH);
 	float vertical = horizontal;
 	float diag = horizontal * 0.3;
-	glm::vec3 focus = poolScene.position;
-	glm::vec3 baseOffset(0.0f, vertical / 3.0f, diag);
+	glm::vec3 baseOffset = glm::vec3(0.0f, vertical / 3.0f, diag) * distanceScale;
 	glm::mat4 rotation(1.0f);
 	rotation = glm::rotate(rotation, glm::radians(gCameraYawOffset), glm::vec3(0.0f, 1.0f, 0.0f));
 	rotation = glm::rotate(rotation, glm::radians(gCameraPitchOffset), glm::vec3(1.0f, 0.0f, 0.0f));
 	glm::vec3 cameraPosition = focus + glm::vec3(rotation * glm::vec4(baseOffset, 0.0f));
-	camera->eye = glm::vec4(cameraPosition, 1.0f);
-	camera->at = glm::vec4(focus, 1.0f);
-	camera->up = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	target->eye = glm::vec4(cameraPosition, 1.0f);
+	target->at = glm::vec4(focus, 1.0f);
+	target->up = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
 }
 
-void drawSkybox()
+void updateViewCameras()
 {
-	GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
-	GLboolean cullEnabled = glIsEnabled(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_CULL_FACE);
-	glDepthMask(GL_FALSE);
-
-	auto drawSkyboxFace = [&](const glm::mat4& baseMatrix, const glm::vec3& translate,
-		const glm::vec3& axis, float angleDegrees, GLuint textureID) {
-		setObjectTexture(SkyboxObject, textureID, glm::vec2(1.0f, 1.0f));
-		SkyboxObject.texOffset = glm::vec2(0.0f, 0.0f);
-		glm::mat4 instance = glm::mat4(1.0f);
-		instance = glm::translate(instance, translate);
-		if (angleDegrees != 0.0f) {
-			instance = glm::rotate(instance, glm::radians(angleDegrees), axis);
+	gViewCount = gSplitScreen ? kMaxViews : 1;
+	gViewCameras[0] = camera;
+	gViewCameras[1] = gSecondCamera;
+	if (gSplitScreen) {
+		updateCameraFollow(camera, gRobotPosition, 0.4f);
+		updateCameraFollow(gSecondCamera, gSecondRobotPosition, 0.4f);
+	}
+	else {
+		updateCameraFollow(camera, poolScene.position, 1.0f);
+	}
+
+	// 分屏时每个视图占场景宽度的一部分
+	int sceneWidth = gDynamicResolution.getSceneWidth();
+	int sceneHeight = gDynamicResolution.getSceneHeight();
+	for (int view = 0; view < gViewCount; view++) {
+		Camera* viewCamera = gViewCameras[view];
+		int left = sceneWidth * view / gViewCount;
+		int right = sceneWidth * (view + 1) / gViewCount;
+		if (sceneHeight > 0 && right > left) {
+			viewCamera->aspect = static_cast<float>(right - left) / static_cast<float>(sceneHeight);
 		}
-		instance = glm::scale(instance, glm::vec3(poolScene.SKYBOX_SIZE));
-		drawMesh(baseMatrix * instance, Skybox, SkyboxObject);
-	};
+		viewCamera->viewMatrix = viewCamera->getViewMatrix();
+		viewCamera->projMatrix = viewCamera->getProjectionMatrix(false);
+	}
+}
 
-	glm::mat4 baseMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(camera->eye));
-	float halfSize = 0.5f * poolScene.SKYBOX_SIZE;
+// 天空盒只有一次绘制：单位立方体采样立方体贴图，深度固定为1
+void drawSkybox()
+{
+	if (gSkybox.getTexture() == 0) {
+		return;
+	}
+	DrawPacket packet = makePacket(kPassSky, glm::mat4(1.0f), SkyboxObject);
+	resolvePacketShaders(packet);
+	packet.textureID = gSkybox.getTexture();
+	packet.key = RenderQueue::makeKey(kPassSky, packet.shader->program, packet.textureID, 0.0f);
+	gRecordQueue->push(packet);
+}
 
-	drawSkyboxFace(baseMatrix, glm::vec3(0.0f, 0.0f, -halfSize), glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, gSkyboxFrontTexture);
-	drawSkyboxFace(baseMatrix, glm::vec3(0.0f, 0.0f, halfSize), glm::vec3(0.0f, 1.0f, 0.0f), 180.0f, gSkyboxBackTexture);
-	drawSkyboxFace(baseMatrix, glm::vec3(halfSize, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, gSkyboxRightTexture);
-	drawSkyboxFace(baseMatrix, glm::vec3(-halfSize, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 90.0f, gSkyboxLeftTexture);
-	drawSkyboxFace(baseMatrix, glm::vec3(0.0f, halfSize, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), -90.0f, gSkyboxTopTexture);
-	drawSkyboxFace(baseMatrix, glm::vec3(0.0f, -halfSize, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 90.0f, gSkyboxBottomTexture);
+void setMeshMaterial(TriMesh* mesh, float ambient, float diffuse, float specular, float shininess)
+{
+	mesh->setAmbient(glm::vec4(ambient, ambient, ambient, 1.0f));
+	mesh->setDiffuse(glm::vec4(diffuse, diffuse, diffuse, 1.0f));
+	mesh->setSpecular(glm::vec4(specular, specular, specular, 1.0f));
+	mesh->setShininess(shininess);
+}
+
+void bindObjectAndData(TriMesh* mesh, openGLObject& object, const std::string &vshader, const std::string &fshader) {
+
+	// 顶点内容相同的网格（例如各种颜色的立方体）共享同一份顶点缓存
+	object.geometry = gGeometryRegistry.registerMesh(mesh, object.color);
 
-	glDepthMask(GL_TRUE);
-	if (depthTestEnabled) {
-		glEnable(GL_DEPTH_TEST);
+	// 相同的着色器源码只编译链接一次，所有物体共享同一组变体
+	object.shaders = gShaderCache.getVariants(vshader, fshader);
+
+	// 网格上设置的材质进入材质表，相同的材质共用一项
+	object.materialIndex = gMaterialTable.addFromMesh(mesh);
+}
+
+
+#ifndef _WIN32
+// 可执行文件所在目录的绝对路径；argv[0] 可能是相对路径或通过 PATH 启动时只有文件名，
+// 所以先向系统查询可执行文件的实际位置，查询失败时才按 argv[0] 解析
+std::string getExecutableDir()
+{
+	char path[PATH_MAX] = { 0 };
+	char resolved[PATH_MAX] = { 0 };
+	bool found = false;
+#ifdef __APPLE__
+	uint32_t size = sizeof(path);
+	found = _NSGetExecutablePath(path, &size) == 0;
+#else
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if (length > 0) {
+		path[length] = '\0';
+		found = true;
 	}
-	if (cullEnabled) {
-		glEnable(GL_CULL_FACE);
+#endif
+	if (!found) {
+		if (gExecutablePath.find('/') == std::string::npos) {
+			return std::string();
+		}
+		snprintf(path, sizeof(path), "%s", gExecutablePath.c_str());
 	}
+	std::string directory = realpath(path, resolved) != NULL ? resolved : path;
+	size_t pos = directory.find_last_of('/');
+	return pos == std::string::npos ? std::string() : directory.substr(0, pos);
 }
+#endif
 
-void bindObjectAndData(TriMesh* mesh, openGLObject& object, const std::string &vshader, const std::string &fshader) {
+// 程序二进制缓存目录，位于可执行文件所在目录
+std::string getShaderCacheDir()
+{
+#ifdef _WIN32
+	return wideToUtf8(getExeDir()) + "\\shader_cache";
+#else
+	std::string directory = getExecutableDir();
+	if (directory.empty()) {
+		return "shader_cache";
+	}
+	return directory + "/shader_cache";
+#endif
+}
 
-	// 创建顶点数组对象
-	glGenVertexArrays(1, &object.vao);  	// 分配1个顶点数组对象
-	glBindVertexArray(object.vao);  	// 绑定顶点数组对象
-
-	// 创建并初始化顶点缓存对象
-	glGenBuffers(1, &object.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, object.vbo);
-	size_t pointsSize = mesh->getPoints().size() * sizeof(glm::vec3);
-	size_t colorsSize = mesh->getColors().size() * sizeof(glm::vec3);
-	size_t normalsSize = mesh->getNormals().size() * sizeof(glm::vec3);
-	size_t texcoordsSize = mesh->getTexCoords().size() * sizeof(glm::vec2);
-	glBufferData(GL_ARRAY_BUFFER, 
-		pointsSize + colorsSize + normalsSize + texcoordsSize,
-		NULL, 
-		GL_STATIC_DRAW);
-
-	// 修改完TriMesh.cpp的代码成后再打开下面注释，否则程序会报错
-	glBufferSubData(GL_ARRAY_BUFFER, 0, pointsSize, &mesh->getPoints()[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, pointsSize, colorsSize, &mesh->getColors()[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, pointsSize + colorsSize, normalsSize, &mesh->getNormals()[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, pointsSize + colorsSize + normalsSize, texcoordsSize, &mesh->getTexCoords()[0]);
-
-	object.vshader = vshader;
-	object.fshader = fshader;
-	object.program = InitShader(object.vshader.c_str(), object.fshader.c_str());
-
-	// 从顶点着色器中初始化顶点的坐标
-	object.pLocation = glGetAttribLocation(object.program, "vPosition");
-	glEnableVertexAttribArray(object.pLocation);
-	glVertexAttribPointer(object.pLocation, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
-
-	// 从顶点着色器中初始化顶点的颜色
-	object.cLocation = glGetAttribLocation(object.program, "vColor");
-	glEnableVertexAttribArray(object.cLocation);
-	glVertexAttribPointer(object.cLocation, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(mesh->getPoints().size() * sizeof(glm::vec3)));
-
-	// 从顶点着色器中初始化顶点的法向量
-	object.nLocation = glGetAttribLocation(object.program, "vNormal");
-	glEnableVertexAttribArray(object.nLocation);
-	glVertexAttribPointer(object.nLocation, 3, 
-		GL_FLOAT, GL_FALSE, 0, 
-		BUFFER_OFFSET(pointsSize + colorsSize));
-
-	object.tLocation = glGetAttribLocation(object.program, "vTexCoord");
-	glEnableVertexAttribArray(object.tLocation);
-	glVertexAttribPointer(object.tLocation, 2,
-		GL_FLOAT, GL_FALSE, 0,
-		BUFFER_OFFSET(pointsSize + colorsSize + normalsSize));
-
-
-	// 获得矩阵位置
-	object.modelLocation = glGetUniformLocation(object.program, "model");
-	object.viewLocation = glGetUniformLocation(object.program, "view");
-	object.projectionLocation = glGetUniformLocation(object.program, "projection");
-
-	object.shadowLocation = glGetUniformLocation(object.program, "isShadow");
-	object.textureLocation = glGetUniformLocation(object.program, "tex");
-	object.useTextureLocation = glGetUniformLocation(object.program, "useTexture");
-	object.texScaleLocation = glGetUniformLocation(object.program, "texScale");
-	object.texOffsetLocation = glGetUniformLocation(object.program, "texOffset");
-	object.colorTintLocation = glGetUniformLocation(object.program, "colorTint");
-	object.alphaLocation = glGetUniformLocation(object.program, "alpha");
-	object.useLightingLocation = glGetUniformLocation(object.program, "useLighting");
-	object.lightPosLocation = glGetUniformLocation(object.program, "lightPos");
-	object.lightColorLocation = glGetUniformLocation(object.program, "lightColor");
-	object.ambientStrengthLocation = glGetUniformLocation(object.program, "ambientStrength");
-	object.specStrengthLocation = glGetUniformLocation(object.program, "specStrength");
-	object.shininessLocation = glGetUniformLocation(object.program, "shininess");
-	object.eyePositionLocation = glGetUniformLocation(object.program, "eye_position");
-	object.shadowAlphaLocation = glGetUniformLocation(object.program, "shadowAlpha");
-}
-
-
-void bindLightAndMaterial(TriMesh* mesh, openGLObject& object, Light* light, Camera* camera) {
-
-	// 传递相机的位置
-	glUniform3fv(glGetUniformLocation(object.program, "eye_position"), 1, &camera->eye[0]);
-
-	// 传递物体的材质
-	glm::vec4 meshAmbient = mesh->getAmbient();
-	glm::vec4 meshDiffuse = mesh->getDiffuse();
-	glm::vec4 meshSpecular = mesh->getSpecular();
-	float meshShininess = mesh->getShininess();
-	glUniform4fv(glGetUniformLocation(object.program, "material.ambient"), 1, &meshAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.diffuse"), 1, &meshDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "material.specular"), 1, &meshSpecular[0]);
-	glUniform1f(glGetUniformLocation(object.program, "material.shininess"), meshShininess);
-
-	// 传递光源信息
-	glm::vec4 lightAmbient = light->getAmbient();
-	glm::vec4 lightDiffuse = light->getDiffuse();
-	glm::vec4 lightSpecular = light->getSpecular();
-	glm::vec3 lightPosition = light->getTranslation();
-
-	glUniform4fv(glGetUniformLocation(object.program, "light.ambient"), 1, &lightAmbient[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.diffuse"), 1, &lightDiffuse[0]);
-	glUniform4fv(glGetUniformLocation(object.program, "light.specular"), 1, &lightSpecular[0]);
-	glUniform3fv(glGetUniformLocation(object.program, "light.position"), 1, &lightPosition[0]);
+// 读取画质配置文件，没有配置文件时保持默认的高画质
+bool loadQualityConfig(QualitySettings& settings)
+{
+	std::string path = resolveAssetPath(kQualityConfigFile);
+	if (!QualitySettings::load(path, settings)) {
+		return false;
+	}
+	std::cout << "Loaded quality settings: " << path << std::endl;
+	return true;
+}
 
+// 只影响提交方式的设置，每帧生效，不需要重建数据
+void applyRenderSettings()
+{
+	gRenderQueue.setOpaqueOrder(gQuality.frontToBack ? kOpaqueOrderFrontToBack : kOpaqueOrderState);
+	gReducedTransparency.setDivisor(gQuality.transparentDivisor);
+	gDynamicResolution.setScaleRange(gQuality.minRenderScale, gQuality.maxRenderScale);
+	gDynamicResolution.setTargetFrameTime(gQuality.targetFrameTime);
+	if (gDynamicResolution.isEnabled() != gQuality.dynamicResolution) {
+		gDynamicResolution.setEnabled(gQuality.dynamicResolution);
+	}
 }
 
+// 运行时切换画质：只重建发生变化的部分
+void applyQualitySettings(const QualitySettings& settings)
+{
+	QualitySettings previous = gQuality;
+	gQuality = settings;
+	gQuality.clamp();
+
+	if (gQuality.crowdDensity != previous.crowdDensity) {
+		buildSpectatorLayout(gSpectatorLayout);
+		gSpectatorCrowd.setInstances(gSpectatorLayout);
+	}
+	bool texturesChanged = kEnableTextures && gQuality.textureSize != previous.textureSize;
+	if (texturesChanged) {
+		loadSceneTextures();
+	}
+	// 静态合批记录了着色器变体、阴影绘制和纹理名
+	if (texturesChanged || gQuality.perPixelLighting != previous.perPixelLighting ||
+		gQuality.planarShadows != previous.planarShadows) {
+		buildStaticBatch();
+	}
+	applyRenderSettings();
+	gQuality.print(std::cout);
+}
 
 void init()
 {
@@ -1784,6 +2475,29 @@ void init()
 	fshader = "shaders/fshader.glsl";
 	stbi_set_flip_vertically_on_load(true);
 
+	// 画质设置决定下面加载的纹理尺寸、观众数量等
+	loadQualityConfig(gQuality);
+	gQuality.clamp();
+
+	// 之前运行时保存的程序二进制可以跳过编译
+	if (gProgramBinaryCache.init(getShaderCacheDir())) {
+		gShaderCache.setBinaryCache(&gProgramBinaryCache);
+	}
+
+	// 每帧数据的 uniform buffer，所有程序的 FrameData 都绑定到同一个绑定点
+	gShaderCache.bindUniformBlock("FrameData", kFrameUniformBinding);
+	gShaderCache.bindUniformBlock("Materials", kMaterialUniformBinding);
+	gShaderCache.bindSampler("tex", 0);
+	gShaderCache.bindSampler("skybox", kSkyboxTextureUnit);
+	gShaderCache.bindSampler("transparentColor", kTransparentColorUnit);
+	gShaderCache.bindSampler("transparentDepth", kTransparentDepthUnit);
+	gShaderCache.bindSampler("sceneDepth", kSceneDepthUnit);
+	// 立方体贴图的面之间按相邻面过滤，没有接缝
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	gGeometryRegistry.setVertexPacking(gVertexPacking);
+	gStaticBatch.setVertexPacking(gVertexPacking);
+	gFrameUniforms.create(kFrameUniformBinding, sizeof(FrameUniforms), kMaxViews);
+
 	gRobotPosition = glm::vec3(
 		getPoolStartX(),
 		getRobotStandY(),
@@ -1824,7 +2538,7 @@ void init()
 	PoolWall->generateCube(White);
 	PoolWater->generateCube(Cyan);
 	Ladder->generateCube(Yellow);
-	Skybox->generateSquare(SkyBlue);
+	Skybox->generateCube(SkyBlue);
 	SchoolBuilding->generateCube(White);
 	SchoolRoof->generateCube(Red);
 	SchoolDoor->generateCube(Brown);
@@ -1836,6 +2550,25 @@ void init()
 	Spectator->generateCube(glm::vec3(0.8f, 0.7f, 0.4f));
 	
 
+	// 设置物体的材质，没有设置的网格使用默认材质（材质表第0项）
+	TriMesh defaultMaterial;
+	gMaterialTable.addFromMesh(&defaultMaterial);
+	TriMesh* plasticMeshes[] = { Torso, Head, RightUpperArm, LeftUpperArm, RightUpperLeg, LeftUpperLeg,
+		RightLowerArm, LeftLowerArm, RightLowerLeg, LeftLowerLeg, SwimRing, LaneFloat };
+	for (TriMesh* mesh : plasticMeshes) {
+		setMeshMaterial(mesh, 0.45f, 1.0f, 0.6f, 64.0f);
+	}
+	TriMesh* tileMeshes[] = { Ground, Deck, PoolBottom, PoolWall };
+	for (TriMesh* mesh : tileMeshes) {
+		setMeshMaterial(mesh, 0.5f, 0.9f, 0.3f, 24.0f);
+	}
+	TriMesh* wallMeshes[] = { CampusWall, SchoolBuilding, SchoolRoof, SchoolDoor, SpectatorStand };
+	for (TriMesh* mesh : wallMeshes) {
+		setMeshMaterial(mesh, 0.5f, 1.0f, 0.1f, 8.0f);
+	}
+	setMeshMaterial(PoolWater, 0.45f, 0.8f, 0.9f, 96.0f);
+	setMeshMaterial(SchoolWindow, 0.4f, 0.8f, 0.8f, 64.0f);
+
 	// 将物体的顶点数据传递
 	bindObjectAndData(Torso, TorsoObject, vshader, fshader);
 	bindObjectAndData(Head, HeadObject, vshader, fshader);
@@ -1854,7 +2587,7 @@ void init()
 	bindObjectAndData(PoolWater, PoolWaterObject, vshader, fshader);
 	PoolWaterObject.alpha = 0.6f;
 	bindObjectAndData(Ladder, LadderObject, vshader, fshader);
-	bindObjectAndData(Skybox, SkyboxObject, vshader, fshader);
+	bindObjectAndData(Skybox, SkyboxObject, "shaders/skybox_vshader.glsl", "shaders/skybox_fshader.glsl");
 	bindObjectAndData(SchoolBuilding, SchoolBuildingObject, vshader, fshader);
 	bindObjectAndData(SchoolRoof, SchoolRoofObject, vshader, fshader);
 	bindObjectAndData(SchoolDoor, SchoolDoorObject, vshader, fshader);
@@ -1864,44 +2597,68 @@ void init()
 	bindObjectAndData(LaneFloat, LaneFloatObject, vshader, fshader);
 	bindObjectAndData(SpectatorStand, SpectatorStandObject, vshader, fshader);
 	bindObjectAndData(Spectator, SpectatorObject, vshader, fshader);
+	setupSpectatorCrowd();
+	if (gCrowdCulling.init(gShaderCache, "shaders/crowd_cull_cshader.glsl", gSpectatorCrowd)) {
+		float centerY = 0.0f;
+		float radius = 0.0f;
+		getSpectatorBounds(centerY, radius);
+		gCrowdCulling.setBounds(centerY, radius);
+	}
+	gGLState.invalidateVertexArray();
+	gMaterialTable.upload(kMaterialUniformBinding);
+
+	// 启动时编译全部变体，避免第一次用到某个变体时在绘制过程中编译
+	ShaderVariants* variants = gShaderCache.getVariants(vshader, fshader);
+	for (unsigned int features = 0; features < kShaderVariantCount; features++) {
+		variants->get(features);
+	}
+	SkyboxObject.shaders->get(0);
 	SkyboxObject.useLighting = 0;
 
 	if (kEnableTextures) {
-		gSkyboxFrontTexture = loadTexture2D(u8"assets/skybox_front.jpg");
-		gSkyboxBackTexture = loadTexture2D(u8"assets/skybox_back.jpg");
-		gSkyboxLeftTexture = loadTexture2D(u8"assets/skybox_left.jpg");
-		gSkyboxRightTexture = loadTexture2D(u8"assets/skybox_right.jpg");
-		gSkyboxTopTexture = loadTexture2D(u8"assets/skybox_top.jpg");
-		gSkyboxBottomTexture = loadTexture2D(u8"assets/skybox_bottom.jpg");
-		GLuint tileTexture = loadTexture2D(u8"assets/pool_ground.jpg");
-		GLuint waterTexture = loadTexture2D(u8"assets/water.jpg");
-		GLuint wallTexture = loadTexture2D(u8"assets/walltexture.jpg");
-		setObjectTexture(SkyboxObject, gSkyboxFrontTexture, glm::vec2(1.0f, 1.0f));
-		setObjectTexture(GroundObject, tileTexture, glm::vec2(6.0f, 6.0f));
-		setObjectTexture(DeckObject, tileTexture, glm::vec2(12.0f, 12.0f));
-		setObjectTexture(PoolWallObject, tileTexture, glm::vec2(4.0f, 2.0f));
-		setObjectTexture(PoolBottomObject, tileTexture, glm::vec2(4.0f, 2.0f));
-		setObjectTexture(PoolWaterObject, waterTexture, glm::vec2(3.0f, 3.0f));
-		setObjectTexture(CampusWallObject, wallTexture, glm::vec2(2.0f, 2.0f));
+		// 场景贴图按尺寸分组放进纹理数组，同一组的物体共用一次纹理绑定
+		loadSceneTextures();
+		loadSkybox();
+		// 立方体贴图上传时直接绑定了纹理
+		gGLState.invalidate();
 	}
 	
+	buildStaticBatch();
+
+	gUpsampleShader = gShaderCache.getProgram("shaders/fullscreen_vshader.glsl", "shaders/upsample_fshader.glsl");
+	glGenVertexArrays(1, &gFullscreenVao);
+	gDynamicResolution.resize(WIDTH, HEIGHT);
+	gReducedTransparency.resize(WIDTH, HEIGHT);
+	applyRenderSettings();
+
+	// 渲染线程自己也执行一个记录任务，工作线程再多也用不上
+	int cores = static_cast<int>(std::thread::hardware_concurrency());
+	gWorkerPool.start((std::min)(cores - 1, kRecordListCount - 1));
+
 	glClearColor(0.25f, 0.6f, 0.9f, 1.0f);
 	announceRaceStatus("Press D to start");
 }
 
 
 
-void display()
+void updateFrameUniforms()
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// 相机矩阵计算
-	updateCameraFollow();
-	camera->viewMatrix = camera->getViewMatrix();
-	camera->projMatrix = camera->getProjectionMatrix(false);
-
-	drawSkybox();
+	for (int view = 0; view < gViewCount; view++) {
+		const Camera* viewCamera = gViewCameras[view];
+		FrameUniforms frame;
+		frame.view = viewCamera->viewMatrix;
+		frame.projection = viewCamera->projMatrix;
+		frame.viewProjection = viewCamera->projMatrix * viewCamera->viewMatrix;
+		frame.lightPosition = glm::vec4(kLightPosition, 1.0f);
+		frame.lightColor = glm::vec4(kLightColor, 1.0f);
+		frame.eyePosition = viewCamera->eye;
+		gFrameUniforms.update(view, &frame);
+	}
+}
 
+// 两个玩家的机器人
+void recordPlayers()
+{
 	// 物体的变换矩阵
 	glm::mat4 modelMatrix = glm::mat4(1.0);
 
@@ -1918,7 +2675,6 @@ void display()
 	float swimLowerLegSwing = inPool ? std::sin(swimPhase + 4.2f) * 15.0f : 0.0f;
 	float swimBodyPitch = inPool ? -90.0f : 0.0f;
 
-	robot.theta[robot.Torso] = gPlayerYaw;
     // 躯干（这里我们希望机器人的躯干只绕Y轴旋转，所以只计算了RotateY）
 	modelMatrix = glm::translate(modelMatrix, robotBase);
 	modelMatrix = glm::scale(modelMatrix, glm::vec3(gPlayerScale));
@@ -2018,20 +2774,158 @@ void display()
 	secondMatrix = glm::scale(secondMatrix, glm::vec3(gSecondScale));
 	secondMatrix = glm::rotate(secondMatrix, glm::radians(gSecondYaw), glm::vec3(0.0f, 1.0f, 0.0f));
 	drawSwimmerRobot(secondMatrix, glm::vec3(0.2f, 0.8f, 0.9f), secondArmSwing, secondLowerArmSwing, secondLegSwing, secondLowerLegSwing, secondBodyPitch, groundTopY, true);
+}
 
+// 玩家编号面向相机，每个视图各生成一份
+void recordPlayerNumbers()
+{
 	glm::vec3 labelOffset(0.0f, robot.TORSO_HEIGHT + robot.HEAD_HEIGHT + 0.8f, 0.0f);
-	drawPlayerNumber(glm::mat4(1.0f), gRobotPosition + labelOffset * gPlayerScale, 1, glm::vec3(1.0f, 0.9f, 0.2f));
-	drawPlayerNumber(glm::mat4(1.0f), gSecondRobotPosition + labelOffset * gSecondScale, 2, glm::vec3(0.2f, 0.9f, 1.0f));
+	for (int view = 0; view < gViewCount; view++) {
+		gPacketViewMask = 1u << view;
+		drawPlayerNumber(glm::mat4(1.0f), gRobotPosition + labelOffset * gPlayerScale, 1, glm::vec3(1.0f, 0.9f, 0.2f),
+			gViewCameras[view]);
+		drawPlayerNumber(glm::mat4(1.0f), gSecondRobotPosition + labelOffset * gSecondScale, 2, glm::vec3(0.2f, 0.9f, 1.0f),
+			gViewCameras[view]);
+	}
+	gPacketViewMask = kAllViews;
+}
 
-	
-	modelMatrix = glm::mat4(1.0);
-	drawAiSwimmers(modelMatrix);
-	swim_venue_scene(modelMatrix);
+void recordAiSwimmers()
+{
+	drawAiSwimmers(glm::mat4(1.0f));
+}
+
+void recordVenue()
+{
+	swim_venue_scene(glm::mat4(1.0f));
+}
+
+// 在记录绘制列表之前剔除观众，记录时绘制包只引用间接绘制命令；只能在渲染线程上调用
+void cullSpectatorCrowd()
+{
+	if (!isGpuCrowdCullingActive() || gSpectatorCrowd.getInstanceCount() == 0) {
+		return;
+	}
+	glm::mat4 viewProjections[kMaxViews];
+	for (int view = 0; view < gViewCount; view++) {
+		viewProjections[view] = gViewCameras[view]->projMatrix * gViewCameras[view]->viewMatrix;
+	}
+	gCrowdCulling.cull(gSpectatorCrowd, getPoolSceneMatrix(), viewProjections, gViewCount, gQuality.planarShadows,
+		kLightPosition, -poolScene.GROUND_DROP);
+	gGLState.invalidateProgram();
+}
+
+void recordCrowd()
+{
+	pool_spectators(getPoolSceneMatrix());
+}
+
+// 每个任务只写自己的绘制列表，只读场景状态，不调用GL；合并按固定顺序进行，结果与单线程遍历相同
+void recordSceneLists()
+{
+	static std::vector<WorkerPool::Task> tasks;
+	if (tasks.empty()) {
+		static void (*const kRecorders[kRecordListCount])() = {
+			recordPlayers, recordPlayerNumbers, recordAiSwimmers, recordVenue, recordCrowd
+		};
+		for (int i = 0; i < kRecordListCount; i++) {
+			tasks.push_back([i]() {
+				RenderQueue* previous = gRecordQueue;
+				gRecordQueue = &gRecordLists[i];
+				kRecorders[i]();
+				gRecordQueue = previous;
+			});
+		}
+	}
+	if (gParallelRecording) {
+		gWorkerPool.run(tasks);
+	}
+	else {
+		for (const WorkerPool::Task& task : tasks) {
+			task();
+		}
+	}
 
+	size_t first = gRenderQueue.size();
+	for (int i = 0; i < kRecordListCount; i++) {
+		gRenderQueue.append(gRecordLists[i]);
+		gRecordLists[i].clear();
+	}
+	for (size_t i = first; i < gRenderQueue.size(); i++) {
+		resolvePacketShaders(gRenderQueue.getPacket(i));
+	}
+}
+
+void display()
+{
+	// 动态分辨率时场景画到离屏缓冲中，清屏也在离屏缓冲上
+	gDynamicResolution.beginFrame();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// 相机矩阵计算；分屏时场景只遍历一次，绘制包在提交时依次画到每个视图
+	updateViewCameras();
+	// 相机与光照每帧只上传一次
+	updateFrameUniforms();
+
+	drawSkybox();
+
+	// 各子系统的绘制列表在工作线程上记录，渲染线程只负责合并和提交；记录时只读取场景状态
+	robot.theta[robot.Torso] = gPlayerYaw;
+	cullSpectatorCrowd();
+	recordSceneLists();
+
+	// 排序并提交本帧所有绘制
+	submitRenderQueue();
 
 }
 
 
+void printRenderStats()
+{
+	const GLStateCache::Stats& stats = gLastFrameStateStats;
+	std::cout << "GL state calls last frame: " << stats.issued << " issued, "
+		<< stats.skipped << " skipped" << std::endl;
+	std::cout << "Draw packets last frame: " << gLastFrameDrawCount << ", views " << gViewCount << std::endl;
+	std::cout << "Draw list recording: " << kRecordListCount << " lists, "
+		<< (gParallelRecording ? gWorkerPool.getThreadCount() : 0) << " worker threads" << std::endl;
+	if (isGpuCrowdCullingActive()) {
+		std::cout << "Spectators: " << gCrowdCulling.readVisibleCount() << " of " << gSpectatorCrowd.getInstanceCount()
+			<< " visible after GPU culling" << std::endl;
+	}
+	else {
+		std::cout << "Spectators: " << gSpectatorCrowd.getInstanceCount() << ", GPU culling "
+			<< (gCrowdCulling.isSupported() ? "off" : "not supported") << std::endl;
+	}
+	gQuality.print(std::cout);
+	if (gReducedTransparency.isEnabled()) {
+		std::cout << "Transparent pass: 1/" << gReducedTransparency.getDivisor() << " resolution ("
+			<< gReducedTransparency.getLowWidth() << "x" << gReducedTransparency.getLowHeight() << ")" << std::endl;
+	}
+	else {
+		std::cout << "Transparent pass: full resolution" << std::endl;
+	}
+	std::cout << "Dynamic resolution: " << (gDynamicResolution.isEnabled() ? "on" : "off") << ", scale "
+		<< gDynamicResolution.getScale() << " (" << gDynamicResolution.getSceneWidth() << "x"
+		<< gDynamicResolution.getSceneHeight() << "), GPU frame " << gDynamicResolution.getGpuFrameTime()
+		<< " ms, target " << gDynamicResolution.getTargetFrameTime() << " ms" << std::endl;
+	gFrameGraph.print(std::cout);
+	std::cout << "Materials: " << gMaterialTable.getCount() << std::endl;
+	std::cout << "Texture arrays: " << gSceneTextures.getArrayCount() << " arrays, "
+		<< gSceneTextures.getLayerCount() << " layers ("
+		<< gSceneTextures.getTextureBytes() << " bytes)" << std::endl;
+	std::cout << "Shader programs: " << gShaderCache.getProgramCount();
+	if (gProgramBinaryCache.isEnabled()) {
+		std::cout << " (" << gProgramBinaryCache.getLoadCount() << " from binary cache, "
+			<< gProgramBinaryCache.getStoreCount() << " stored, "
+			<< gProgramBinaryCache.getRejectCount() << " rejected)";
+	}
+	std::cout << std::endl;
+	std::cout << "Geometry: " << gGeometryRegistry.getUniqueCount() << " meshes ("
+		<< gGeometryRegistry.getBufferBytes() << " bytes)" << std::endl;
+	std::cout << "Static batch: " << gStaticBatch.getSourceDrawCount() << " draws merged into "
+		<< gStaticBatch.getGroupCount() << " groups (" << gStaticBatch.getBufferBytes() << " bytes)" << std::endl;
+}
+
 void printHelp()
 {
 
@@ -2071,7 +2965,22 @@ void printHelp()
 
 		std::endl <<
 		"[Camera]" << std::endl <<
-		"Mouse drag: rotate view" << std::endl << std::endl;
+		"Mouse drag: rotate view" << std::endl <<
+
+		std::endl <<
+		"[Render]" << std::endl <<
+		"F1:		Print render statistics" << std::endl <<
+		"F2:		Toggle instanced spectator crowd" << std::endl <<
+		"F3:		Toggle static scene batching" << std::endl <<
+		"F4:		Toggle depth pre-pass" << std::endl <<
+		"F5:		Toggle front-to-back opaque ordering" << std::endl <<
+		"F6:		Cycle transparent pass resolution (full, 1/2, 1/4)" << std::endl <<
+		"F7:		Toggle dynamic resolution" << std::endl <<
+		"F8:		Cycle quality preset (low, medium, high)" << std::endl <<
+		"F9:		Reload quality settings from " << kQualityConfigFile << std::endl <<
+		"F10:		Toggle split screen" << std::endl <<
+		"F11:		Toggle multi-threaded draw list recording" << std::endl <<
+		"F12:		Toggle GPU culling of the spectator crowd" << std::endl << std::endl;
 
 }
 
@@ -2079,6 +2988,7 @@ void printHelp()
 // 键盘响应函数
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
+	gLastInputTime = glfwGetTime();
 	float tmp;
 	glm::vec4 ambient;
 	if (action == GLFW_PRESS) {
@@ -2177,6 +3087,73 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 				}
 			}
 			break;
+		case GLFW_KEY_F1:
+			printRenderStats();
+			break;
+		case GLFW_KEY_F2:
+			gInstancedCrowd = !gInstancedCrowd;
+			std::cout << "Instanced crowd: " << (gInstancedCrowd ? "on" : "off") << std::endl;
+			break;
+		case GLFW_KEY_F3:
+			gUseStaticBatch = !gUseStaticBatch;
+			std::cout << "Static batching: " << (gUseStaticBatch ? "on" : "off") << std::endl;
+			break;
+		case GLFW_KEY_F4:
+			gQuality.depthPrepass = !gQuality.depthPrepass;
+			std::cout << "Depth pre-pass: " << (gQuality.depthPrepass ? "on" : "off") << std::endl;
+			break;
+		case GLFW_KEY_F5:
+			gQuality.frontToBack = !gQuality.frontToBack;
+			applyRenderSettings();
+			std::cout << "Opaque order: " << (gQuality.frontToBack ? "front to back" : "by state") << std::endl;
+			break;
+		case GLFW_KEY_F6:
+			gQuality.transparentDivisor = gQuality.transparentDivisor >= 4 ? 1 : gQuality.transparentDivisor * 2;
+			applyRenderSettings();
+			if (gReducedTransparency.isEnabled()) {
+				std::cout << "Transparent pass: 1/" << gReducedTransparency.getDivisor() << " resolution" << std::endl;
+			}
+			else {
+				std::cout << "Transparent pass: full resolution" << std::endl;
+			}
+			break;
+		case GLFW_KEY_F7:
+			gQuality.dynamicResolution = !gQuality.dynamicResolution;
+			applyRenderSettings();
+			std::cout << "Dynamic resolution: " << (gDynamicResolution.isEnabled() ? "on" : "off") << std::endl;
+			break;
+		case GLFW_KEY_F8:
+			applyQualitySettings(QualitySettings::fromPreset(
+				static_cast<QualityPreset>((gQuality.preset + 1) % kQualityPresetCount)));
+			break;
+		case GLFW_KEY_F9:
+		{
+			QualitySettings settings = gQuality;
+			if (loadQualityConfig(settings)) {
+				applyQualitySettings(settings);
+			}
+			else {
+				std::cout << "Quality config not found: " << kQualityConfigFile << std::endl;
+			}
+			break;
+		}
+		case GLFW_KEY_F10:
+			gSplitScreen = !gSplitScreen;
+			std::cout << "Split screen: " << (gSplitScreen ? "on" : "off") << std::endl;
+			break;
+		case GLFW_KEY_F11:
+			gParallelRecording = !gParallelRecording;
+			std::cout << "Multi-threaded recording: " << (gParallelRecording ? "on" : "off") << " ("
+				<< gWorkerPool.getThreadCount() << " worker threads)" << std::endl;
+			break;
+		case GLFW_KEY_F12:
+			if (!gCrowdCulling.isSupported()) {
+				std::cout << "GPU crowd culling: not supported (requires OpenGL 4.3)" << std::endl;
+				break;
+			}
+			gGpuCrowdCulling = !gGpuCrowdCulling;
+			std::cout << "GPU crowd culling: " << (gGpuCrowdCulling ? "on" : "off") << std::endl;
+			break;
 		case GLFW_KEY_SPACE:
 			gCameraYawOffset = 0.0f;
 			gCameraPitchOffset = 0.0f;
@@ -2190,6 +3167,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	gLastInputTime = glfwGetTime();
 	if (!gIsDragging) {
 		gLastX = xpos;
 		gLastY = ypos;
@@ -2226,6 +3204,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+	gLastInputTime = glfwGetTime();
 	if (button == GLFW_MOUSE_BUTTON_LEFT) {
 		if (action == GLFW_PRESS) {
 			gIsDragging = true;
@@ -2239,6 +3218,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+	gLastInputTime = glfwGetTime();
 	gCameraFollowDistance -= static_cast<float>(yoffset) * 2.0f;
 	if (gCameraFollowDistance < 3.0f) {
 		gCameraFollowDistance = 3.0f;
@@ -2248,6 +3228,32 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	}
 }
 
+// 比赛未进行、机器人落地且一段时间没有输入时，画面只剩观众和水面的动画，可以降低帧率
+bool isIdle()
+{
+	if (gRaceStarted && !gRaceFinished) {
+		return false;
+	}
+	if (gStartRequested || gIsDragging || gRobotPosition.y > getRobotStandY()) {
+		return false;
+	}
+	return glfwGetTime() - gLastInputTime > gQuality.idleDelay;
+}
+
+// 空闲时等待事件而不是轮询，有输入时立即返回，下一帧恢复全速
+void waitOrPollEvents()
+{
+	if (!isIdle()) {
+		glfwPollEvents();
+	}
+	else if (gQuality.idleFrameRate > 0.0f) {
+		glfwWaitEventsTimeout(1.0 / gQuality.idleFrameRate);
+	}
+	else {
+		glfwWaitEvents();
+	}
+}
+
 void processMovement(GLFWwindow* window, float deltaTime)
 {
 	(void)window;
@@ -2304,9 +3310,28 @@ void processMovement(GLFWwindow* window, float deltaTime)
 
 void cleanData() {
 	
+	// 释放着色器程序
+	gCrowdCulling.clear();
+	gSpectatorCrowd.clear();
+	gStaticBatch.clear();
+	gMaterialTable.clear();
+	gSceneTextures.clear();
+	gSkybox.clear();
+	gFrameGraph.clear();
+	gWorkerPool.stop();
+	gDynamicResolution.clear();
+	glDeleteVertexArrays(1, &gFullscreenVao);
+	gFullscreenVao = 0;
+	gShaderCache.clear();
+	gGeometryRegistry.clear();
+	gGLState.invalidate();
+	gFrameUniforms.clear();
+
 	// 释放内存
 	delete camera;
 	camera = NULL;
+	delete gSecondCamera;
+	gSecondCamera = NULL;
 
 	for (int i=0; i<meshList.size(); i++) {
 		meshList[i]->cleanData();
@@ -2320,6 +3345,9 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
 int main(int argc, char **argv)
 {
+	if (argc > 0) {
+		gExecutablePath = argv[0];
+	}
 	// 初始化GLFW库，必须是应用程序调用的第一个GLFW函数
 	glfwInit();
 
@@ -2327,6 +3355,9 @@ int main(int argc, char **argv)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// 低分辨率半透明阶段直接 blit 默认帧缓冲的深度，格式需要是 GL_DEPTH24_STENCIL8
+	glfwWindowHint(GLFW_DEPTH_BITS, 24);
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
 
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -2372,17 +3403,23 @@ int main(int argc, char **argv)
 	// 输出帮助信息
 	printHelp();
 	// 启用深度测试
-	glEnable(GL_DEPTH_TEST);
+	gGLState.setDepthTest(true);
 	float lastFrame = static_cast<float>(glfwGetTime());
+	gLastInputTime = glfwGetTime();
 	while (!glfwWindowShouldClose(window))
 	{
+		// 先处理事件，空闲时等待的时间计入本帧的 deltaTime
+		waitOrPollEvents();
+
 		float currentFrame = static_cast<float>(glfwGetTime());
 		float deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		glfwPollEvents();
 		processMovement(window, deltaTime);
+		gGLState.resetStats();
 		display();
+		gDynamicResolution.endFrame();
+		gLastFrameStateStats = gGLState.getStats();
 
 		// 交换颜色缓冲 以及 检查有没有触发什么事件（比如键盘输入、鼠标移动等）
 		// -------------------------------------------------------------------------------
@@ -2399,11 +3436,14 @@ int main(int argc, char **argv)
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+	gLastInputTime = glfwGetTime();
 	// make sure the viewport matches the new window dimensions; note that width and 
 	// height will be significantly larger than specified on retina displays.
 	glViewport(0, 0, width, height);
 	WIDTH = width;
 	HEIGHT = height;
+	gDynamicResolution.resize(width, height);
+	gReducedTransparency.resize(width, height);
 	if (height > 0 && camera) {
 		camera->aspect = static_cast<float>(width) / static_cast<float>(height);
 	}
@@ -0,0 +1,104 @@
+#version 430 core
+
+// 观众的GPU剔除（GpuCrowdCulling）：每个线程测试一个观众的包围球，
+// 在任一视图的视锥体内、或它的平面阴影在视锥体内时，追加到可见实例缓存。
+// 定义 FINALIZE 时为第二个阶段：把可见数量写入每个身体部位的间接绘制命令
+layout(local_size_x = 64) in;
+
+// 与 SpectatorCrowd.h 中的 CrowdInstance 对应
+struct CrowdInstance
+{
+	vec4 positionScale;	// xyz: 站立位置, w: 整体缩放
+	vec4 tintPhase;		// rgb: 衣服颜色, a: 动画相位
+};
+
+layout(std430, binding = 0) readonly buffer Instances
+{
+	CrowdInstance instances[];
+};
+
+layout(std430, binding = 1) writeonly buffer VisibleInstances
+{
+	CrowdInstance visibleInstances[];
+};
+
+// commands[0] 为可见数量的计数器，从 commands[4] 开始每条命令5个 uint，第1个为 instanceCount
+layout(std430, binding = 2) buffer Commands
+{
+	uint commands[];
+};
+
+#define COMMAND_START 4
+#define COMMAND_STRIDE 5
+
+#ifdef FINALIZE
+
+uniform uint partCount;
+
+void main()
+{
+	uint part = gl_GlobalInvocationID.x;
+	if (part < partCount) {
+		commands[COMMAND_START + part * COMMAND_STRIDE + 1] = commands[0];
+	}
+}
+
+#else
+
+#define MAX_VIEWS 2
+
+uniform mat4 crowdModel;					// 人群整体的变换
+uniform vec4 frustumPlanes[MAX_VIEWS * 6];	// 每个视图6个平面，法线朝内
+uniform int viewCount;
+uniform vec2 bounds;						// x: 包围球心的高度, y: 半径（缩放前）
+uniform vec4 shadowLight;					// xyz: 光源位置, w: 阴影平面的高度
+uniform int castShadows;
+uniform uint instanceCount;
+
+bool isSphereVisible(vec3 center, float radius)
+{
+	for (int view = 0; view < viewCount; view++) {
+		bool inside = true;
+		for (int i = 0; i < 6; i++) {
+			vec4 plane = frustumPlanes[view * 6 + i];
+			if (dot(plane.xyz, center) + plane.w < -radius) {
+				inside = false;
+				break;
+			}
+		}
+		if (inside) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= instanceCount) {
+		return;
+	}
+	CrowdInstance instance = instances[index];
+	float scale = instance.positionScale.w;
+	vec3 center = (crowdModel * vec4(instance.positionScale.xyz + vec3(0.0, bounds.x * scale, 0.0), 1.0)).xyz;
+	float radius = bounds.y * scale * length(crowdModel[0].xyz);
+
+	bool visible = isSphereVisible(center, radius);
+	if (!visible && castShadows != 0 && center.y < shadowLight.y) {
+		// 与 shadowMatrixYPlane 相同，从光源把球心投影到阴影平面上；
+		// 半径按到平面的距离放大，再按光线斜射时影子拉长的程度放大，保证保守
+		vec3 toCenter = center - shadowLight.xyz;
+		float height = shadowLight.y - center.y;
+		float stretch = (shadowLight.y - shadowLight.w) / height;
+		vec3 shadowCenter = shadowLight.xyz + toCenter * stretch;
+		float shadowRadius = radius * stretch * length(toCenter) / height;
+		visible = isSphereVisible(shadowCenter, shadowRadius);
+	}
+	if (visible) {
+		uint slot = atomicAdd(commands[0], 1u);
+		visibleInstances[slot] = instance;
+	}
+}
+
+#endif
@@ -1,55 +1,129 @@
 #version 330 core
 
+// 变体宏定义（由 ShaderVariants 插入到 #version 之后）：
+// SHADOW_ONLY 只输出阴影颜色；USE_TEXTURE 采样纹理；USE_LIGHTING 计算光照；
+// CROWD_INSTANCING 乘以逐实例的颜色；TRIPLANAR 不使用纹理坐标，按世界坐标和法向量三向投影采样；
+// DEPTH_ONLY 深度预渲染，不输出颜色；VERTEX_LIGHTING 使用顶点着色器算好的光照
+
+#if defined(DEPTH_ONLY)
+
+void main()
+{
+}
+
+#elif defined(SHADOW_ONLY)
+
+uniform float shadowAlpha;
+
+out vec4 fColor;
+
+void main()
+{
+	fColor = vec4(0.0, 0.0, 0.0, shadowAlpha);
+}
+
+#else
+
 in vec3 position;
 in vec3 normal;
 in vec3 color;
 in vec2 texCoord;
 
-uniform int isShadow;
-uniform int useTexture;
-uniform int useLighting;
-uniform sampler2D tex;
-uniform vec2 texScale;
-uniform vec2 texOffset;
+#ifdef CROWD_INSTANCING
+in vec3 instanceTint;
+#endif
+
 uniform vec3 colorTint;
 uniform float alpha;
-uniform float shadowAlpha;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform float ambientStrength;
-uniform float specStrength;
-uniform float shininess;
-uniform vec3 eye_position;
+
+#ifdef USE_TEXTURE
+// 场景贴图都在一个纹理数组中，层号来自顶点属性
+uniform sampler2DArray tex;
+flat in int textureLayer;
+// TRIPLANAR 时 texScale 为每个世界单位重复的次数
+uniform vec2 texScale;
+uniform vec2 texOffset;
+#endif
+
+#ifdef TRIPLANAR
+// 三个轴向的投影按法向量分量的四次方混合，拉伸的长方体上纹理密度也保持一致
+vec4 sampleTriplanar(vec3 p, vec3 n)
+{
+	vec3 weights = pow(abs(normalize(n)), vec3(4.0));
+	weights /= weights.x + weights.y + weights.z;
+	float layer = float(textureLayer);
+	vec4 sampleX = texture(tex, vec3(p.zy * texScale + texOffset, layer));
+	vec4 sampleY = texture(tex, vec3(p.xz * texScale + texOffset, layer));
+	vec4 sampleZ = texture(tex, vec3(p.xy * texScale + texOffset, layer));
+	return sampleX * weights.x + sampleY * weights.y + sampleZ * weights.z;
+}
+#endif
+
+#if defined(USE_LIGHTING) && defined(VERTEX_LIGHTING)
+in vec3 vertexLighting;
+#elif defined(USE_LIGHTING)
+// 每帧只更新一次的相机与光照数据（std140，与 main.cpp 中的 FrameUniforms 对应）
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 lightPosition;
+	vec4 lightColor;
+	vec4 eyePosition;
+};
+
+// 材质表（std140，与 MaterialTable.h 中的 MaterialData 对应），数组大小与 kMaxMaterials 一致
+#define MAX_MATERIALS 64
+struct Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;	// w: 高光系数
+};
+layout(std140) uniform Materials
+{
+	Material materials[MAX_MATERIALS];
+};
+
+flat in int materialIndex;
+#endif
 
 out vec4 fColor;
 
 void main()
 {
-	if (isShadow == 1) {
-		fColor = vec4(0.0, 0.0, 0.0, shadowAlpha);
-	}
-	else {
-		vec4 baseColor = vec4(color, 1.0);
-		if (useTexture == 1) {
-			baseColor = texture(tex, texCoord * texScale + texOffset);
-		}
-		baseColor.rgb *= colorTint;
-		baseColor.a *= alpha;
-		if (useLighting == 1) {
-			vec3 norm = normalize(normal);
-			vec3 lightDir = normalize(lightPos - position);
-			float diff = max(dot(norm, lightDir), 0.0);
-			vec3 viewDir = normalize(eye_position - position);
-			vec3 reflectDir = reflect(-lightDir, norm);
-			float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
-			vec3 ambient = ambientStrength * lightColor;
-			vec3 diffuse = diff * lightColor;
-			vec3 specular = specStrength * spec * lightColor;
-			vec3 lighting = ambient + diffuse + specular;
-			fColor = vec4(baseColor.rgb * lighting, baseColor.a);
-		}
-		else {
-			fColor = baseColor;
-		}
-	}
+#if defined(TRIPLANAR)
+	vec4 baseColor = sampleTriplanar(position, normal);
+#elif defined(USE_TEXTURE)
+	vec4 baseColor = texture(tex, vec3(texCoord * texScale + texOffset, float(textureLayer)));
+#else
+	vec4 baseColor = vec4(color, 1.0);
+#endif
+	baseColor.rgb *= colorTint;
+#ifdef CROWD_INSTANCING
+	baseColor.rgb *= instanceTint;
+#endif
+	baseColor.a *= alpha;
+
+#if defined(USE_LIGHTING) && defined(VERTEX_LIGHTING)
+	fColor = vec4(baseColor.rgb * vertexLighting, baseColor.a);
+#elif defined(USE_LIGHTING)
+	Material material = materials[materialIndex];
+	vec3 norm = normalize(normal);
+	vec3 lightDir = normalize(lightPosition.xyz - position);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 viewDir = normalize(eyePosition.xyz - position);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.specular.w);
+	vec3 ambient = material.ambient.rgb * lightColor.rgb;
+	vec3 diffuse = diff * material.diffuse.rgb * lightColor.rgb;
+	vec3 specular = spec * material.specular.rgb * lightColor.rgb;
+	vec3 lighting = ambient + diffuse + specular;
+	fColor = vec4(baseColor.rgb * lighting, baseColor.a);
+#else
+	fColor = baseColor;
+#endif
 }
+
+#endif
@@ -0,0 +1,11 @@
+#version 330 core
+
+// 全屏三角形：不需要顶点缓存，由 gl_VertexID 生成覆盖整个视口的三个顶点
+out vec2 screenTexCoord;
+
+void main()
+{
+	vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+	screenTexCoord = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
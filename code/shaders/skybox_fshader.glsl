@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 direction;
+
+uniform samplerCube skybox;
+
+out vec4 fColor;
+
+void main()
+{
+	// 立方体贴图按左手坐标系排列面，翻转 z 后 +Z 面位于相机默认朝向（-Z）的前方
+	fColor = texture(skybox, vec3(direction.x, direction.y, -direction.z));
+}
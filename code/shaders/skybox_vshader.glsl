@@ -0,0 +1,32 @@
+#version 330 core
+
+// 天空盒：单位立方体，方向向量直接作为立方体贴图的采样方向
+layout(location = 0) in vec3 vPosition;
+
+// 量化位置的反量化参数（VertexFormat）
+layout(location = 7) in vec3 vPositionScale;
+layout(location = 8) in vec3 vPositionOffset;
+
+out vec3 direction;
+
+// 每帧只更新一次的相机与光照数据（std140，与 main.cpp 中的 FrameUniforms 对应）
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 lightPosition;
+	vec4 lightColor;
+	vec4 eyePosition;
+};
+
+void main()
+{
+	vec3 objectPosition = vPosition * vPositionScale + vPositionOffset;
+	direction = objectPosition;
+
+	// 只保留视图矩阵的旋转，天空盒始终以相机为中心
+	vec4 clipPosition = projection * vec4(mat3(view) * objectPosition, 1.0);
+	// z = w，深度恰好为1，只在没有被不透明物体覆盖的像素上通过 LEQUAL 测试
+	gl_Position = clipPosition.xyww;
+}
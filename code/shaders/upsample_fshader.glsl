@@ -0,0 +1,57 @@
+#version 330 core
+
+// 低分辨率半透明目标的双边上采样：取双线性插值的四个低分辨率像素，
+// 再按它们的场景深度与当前像素的场景深度之差降低权重，深度不连续处不会把水面颜色涂到前景物体上
+in vec2 screenTexCoord;
+
+uniform sampler2D transparentColor;	// 预乘颜色，透明度为覆盖率
+uniform sampler2D transparentDepth;	// 低分辨率的场景深度
+uniform sampler2D sceneDepth;		// 全分辨率的场景深度
+// 纹理按窗口尺寸分配，动态分辨率时只有左下角的区域有效
+uniform vec2 transparentScale;		// 场景像素坐标到低分辨率像素坐标的比例
+uniform vec2 transparentSize;		// 低分辨率目标中有效区域的尺寸
+
+// 每帧只更新一次的相机与光照数据（std140，与 main.cpp 中的 FrameUniforms 对应）
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 lightPosition;
+	vec4 lightColor;
+	vec4 eyePosition;
+};
+
+out vec4 fColor;
+
+// 深度缓存的值换算为到相机的距离
+float linearDepth(float depth)
+{
+	float ndc = depth * 2.0 - 1.0;
+	return projection[3][2] / (ndc + projection[2][2]);
+}
+
+void main()
+{
+	ivec2 lowSize = ivec2(transparentSize);
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = linearDepth(texelFetch(sceneDepth, pixel, 0).r);
+
+	vec2 lowPosition = gl_FragCoord.xy * transparentScale - 0.5;
+	ivec2 base = ivec2(floor(lowPosition));
+	vec2 f = lowPosition - vec2(base);
+
+	vec4 sum = vec4(0.0);
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+		float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float lowDepth = linearDepth(texelFetch(transparentDepth, texel, 0).r);
+		// 相对深度差，远处的像素不会因为深度值较大而被整体压低权重
+		float weight = (bilinear + 1e-4) / (abs(lowDepth - depth) / depth + 1e-3);
+		sum += texelFetch(transparentColor, texel, 0) * weight;
+		weightSum += weight;
+	}
+	fColor = sum / weightSum;
+}
@@ -1,29 +1,150 @@
 #version 330 core
 
-in vec3 vPosition;
-in vec3 vColor;
-in vec3 vNormal;
-in vec2 vTexCoord;
+layout(location = 0) in vec3 vPosition;
+layout(location = 1) in vec3 vColor;
+layout(location = 2) in vec3 vNormal;
+layout(location = 3) in vec2 vTexCoord;
+layout(location = 6) in int vMaterialIndex;
+layout(location = 9) in int vTextureLayer;
+
+// 量化位置按包围盒反量化（VertexFormat），未量化时为 scale = 1, offset = 0
+layout(location = 7) in vec3 vPositionScale;
+layout(location = 8) in vec3 vPositionOffset;
 
 out vec3 position;
 out vec3 normal;
 out vec3 color;
 out vec2 texCoord;
+flat out int materialIndex;
+flat out int textureLayer;
+
+// 每帧只更新一次的相机与光照数据（std140，与 main.cpp 中的 FrameUniforms 对应）
+layout(std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 lightPosition;
+	vec4 lightColor;
+	vec4 eyePosition;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#ifdef VERTEX_LIGHTING
+// 低画质时光照在顶点上计算，片元只做插值（材质表与 fshader.glsl 中的相同）
+#define MAX_MATERIALS 64
+struct Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;	// w: 高光系数
+};
+layout(std140) uniform Materials
+{
+	Material materials[MAX_MATERIALS];
+};
+
+out vec3 vertexLighting;
+#endif
+
+// 深度预渲染和颜色阶段使用不同的变体，深度必须逐位相同才能用 GL_EQUAL 比较
+invariant gl_Position;
+
+#ifdef CROWD_INSTANCING
+// 逐实例属性（SpectatorCrowd 的实例缓存）
+layout(location = 4) in vec4 vInstancePosition;	// xyz: 站立位置, w: 整体缩放
+layout(location = 5) in vec4 vInstanceTint;		// rgb: 衣服颜色, a: 动画相位
+
+uniform float crowdTime;
+uniform vec3 crowdTarget;
+
+// 当前身体部位的关节链
+uniform vec3 partPivot;
+uniform vec3 partChildOffset;
+uniform vec2 partSwing;
+uniform mat4 partLocal;
+
+out vec3 instanceTint;
+
+mat4 translation(vec3 t)
+{
+	return mat4(1.0, 0.0, 0.0, 0.0,
+		0.0, 1.0, 0.0, 0.0,
+		0.0, 0.0, 1.0, 0.0,
+		t.x, t.y, t.z, 1.0);
+}
+
+mat4 rotationY(float angle)
+{
+	float c = cos(angle);
+	float s = sin(angle);
+	return mat4(c, 0.0, -s, 0.0,
+		0.0, 1.0, 0.0, 0.0,
+		s, 0.0, c, 0.0,
+		0.0, 0.0, 0.0, 1.0);
+}
+
+mat4 rotationZ(float angle)
+{
+	float c = cos(angle);
+	float s = sin(angle);
+	return mat4(c, s, 0.0, 0.0,
+		-s, c, 0.0, 0.0,
+		0.0, 0.0, 1.0, 0.0,
+		0.0, 0.0, 0.0, 1.0);
+}
+
+// 与 drawSpectatorRobot 相同的变换：面向目标，欢呼时挥动双臂
+mat4 crowdModel()
+{
+	vec2 toTarget = crowdTarget.xz - vInstancePosition.xz;
+	float yaw = length(toTarget) > 0.001 ? atan(toTarget.x, -toTarget.y) : 0.0;
+	float cheer = sin(crowdTime * 4.0 + vInstanceTint.a);
+	float upperArmAngle = radians(-(60.0 + 25.0 * cheer));
+	float lowerArmAngle = radians(-(20.0 + 15.0 * cheer));
+
+	mat4 body = translation(vInstancePosition.xyz) * rotationY(yaw);
+	body[0] *= vInstancePosition.w;
+	body[1] *= vInstancePosition.w;
+	body[2] *= vInstancePosition.w;
+	return body * translation(partPivot) * rotationZ(partSwing.x * upperArmAngle)
+		* translation(partChildOffset) * rotationZ(partSwing.y * lowerArmAngle) * partLocal;
+}
+#endif
 
 void main()
 {
-	vec4 v1 = model * vec4(vPosition, 1.0);
+#ifdef CROWD_INSTANCING
+	// model 为人群整体的变换（绘制阴影时为阴影投影矩阵）
+	mat4 objectModel = model * crowdModel();
+	instanceTint = vInstanceTint.rgb;
+#else
+	mat4 objectModel = model;
+#endif
+
+	vec3 objectPosition = vPosition * vPositionScale + vPositionOffset;
+	vec4 v1 = objectModel * vec4(objectPosition, 1.0);
 	vec4 v2 = vec4(v1.xyz / v1.w, 1.0);
-	vec4 v3 = projection * view * v2;
+	vec4 v3 = viewProjection * v2;
 
 	gl_Position = v3;
 
 	position = vec3(v2.xyz);
-	normal = vec3(model * vec4(vNormal, 0.0));
+	normal = vec3(objectModel * vec4(vNormal, 0.0));
 	color = vColor;
 	texCoord = vTexCoord;
+	materialIndex = vMaterialIndex;
+	textureLayer = vTextureLayer;
+
+#ifdef VERTEX_LIGHTING
+	Material material = materials[vMaterialIndex];
+	vec3 norm = normalize(normal);
+	vec3 lightDir = normalize(lightPosition.xyz - position);
+	float diff = max(dot(norm, lightDir), 0.0);
+	vec3 viewDir = normalize(eyePosition.xyz - position);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.specular.w);
+	vertexLighting = (material.ambient.rgb + diff * material.diffuse.rgb + spec * material.specular.rgb) * lightColor.rgb;
+#endif
 }